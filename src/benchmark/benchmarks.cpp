@@ -0,0 +1,193 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TestCallbacks.h"
+#include "TestUtils.h"
+
+#include "AttributeConversion.h"
+#include "ModelConverter.h"
+#include "PRTContext.h"
+#include "Utils.h"
+
+#include "GU/GU_Detail.h"
+
+#define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch2/catch.hpp"
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+PRTContextUPtr prtCtx;
+const std::filesystem::path testDataPath = TEST_DATA_PATH;
+
+// the mesh is added this many times (as separate initial shapes) per benchmark run
+constexpr size_t HOLES_REPETITIONS = 1000;
+
+// feeds the generated mesh into a model converter like the encoder would, then builds the holes
+GA_Size convertHoles(const CallbackResult& cr, bool bridgeHoles) {
+	std::vector<const double*> uvs;
+	std::vector<const uint32_t*> uvCounts, uvIndices;
+	std::vector<size_t> uvsSizes, uvCountsSizes, uvIndicesSizes;
+	for (size_t uvSet = 0; uvSet < cr.uvCounts.size(); uvSet++) {
+		uvs.push_back(cr.uvs[uvSet].data());
+		uvsSizes.push_back(cr.uvs[uvSet].size());
+		uvCounts.push_back(cr.uvCounts[uvSet].data());
+		uvCountsSizes.push_back(cr.uvCounts[uvSet].size());
+		uvIndices.push_back(cr.uvIndices[uvSet].data());
+		uvIndicesSizes.push_back(cr.uvIndices[uvSet].size());
+	}
+	std::vector<const prt::AttributeMap*> materials;
+	for (const AttributeMapUPtr& m : cr.materials)
+		materials.push_back(m.get());
+	const std::vector<int32_t> shapeIDs(cr.faceRanges.size(), 0);
+
+	GU_Detail detail;
+	std::mutex detailMutex;
+	std::vector<prt::Status> statuses(HOLES_REPETITIONS, prt::STATUS_OK);
+	PrimitiveCreation primitiveCreation;
+	primitiveCreation.bridgeHoles = bridgeHoles;
+	ModelConverter modelConverter(&detail, detailMutex, GroupCreation::NONE, statuses, nullptr, nullptr, nullptr,
+	                              primitiveCreation);
+
+	HoudiniCallbacks& callbacks = modelConverter;
+	for (size_t isIndex = 0; isIndex < HOLES_REPETITIONS; isIndex++) {
+		callbacks.add(isIndex, cr.name.c_str(), cr.vtx.data(), cr.vtx.size(), cr.nrm.data(), cr.nrm.size(),
+		              cr.cnts.data(), cr.cnts.size(), cr.holeCnts.data(), cr.holeCnts.size(), cr.holeIdx.data(),
+		              cr.holeIdx.size(), cr.vtxIdx.data(), cr.vtxIdx.size(), cr.nrmIdx.data(), cr.nrmIdx.size(),
+		              uvs.data(), uvsSizes.data(), uvCounts.data(), uvCountsSizes.data(), uvIndices.data(),
+		              uvIndicesSizes.data(), static_cast<uint32_t>(cr.uvCounts.size()), cr.faceRanges.data(),
+		              cr.faceRanges.size(), materials.data(), nullptr, shapeIDs.data());
+	}
+	modelConverter.buildHoles();
+	return detail.getNumPrimitives();
+}
+
+// one face range over this many primitives, like the generic attributes of a large initial shape
+constexpr GA_Size ATTRIBUTE_PRIMITIVES = 100000;
+constexpr size_t ATTRIBUTE_ARRAY_SIZE = 8;
+const std::wstring FLOAT_ARRAY_KEY = L"floatArray";
+const std::wstring STRING_ARRAY_KEY = L"stringArray";
+
+AttributeMapUPtr createArrayAttributes() {
+	std::vector<double> floats(ATTRIBUTE_ARRAY_SIZE);
+	std::vector<std::wstring> strings(ATTRIBUTE_ARRAY_SIZE);
+	std::vector<const wchar_t*> stringPtrs(ATTRIBUTE_ARRAY_SIZE);
+	for (size_t i = 0; i < ATTRIBUTE_ARRAY_SIZE; i++) {
+		floats[i] = static_cast<double>(i) * 0.5;
+		strings[i] = L"value" + std::to_wstring(i);
+		stringPtrs[i] = strings[i].c_str();
+	}
+
+	AttributeMapBuilderUPtr amb(prt::AttributeMapBuilder::create());
+	amb->setFloatArray(FLOAT_ARRAY_KEY.c_str(), floats.data(), floats.size());
+	amb->setStringArray(STRING_ARRAY_KEY.c_str(), stringPtrs.data(), stringPtrs.size());
+	return AttributeMapUPtr(amb->createAttributeMap());
+}
+
+// the previous per-primitive path: every primitive gets its own copy of the arrays
+void setArrayAttributesPerPrimitive(GU_Detail& detail, const prt::AttributeMap* attrMap, GA_Offset rangeStart) {
+	size_t floatsSize = 0;
+	const double* floats = attrMap->getFloatArray(FLOAT_ARRAY_KEY.c_str(), &floatsSize);
+	UT_Fpreal64Array floatValue;
+	floatValue.append(floats, floatsSize);
+
+	size_t stringsSize = 0;
+	wchar_t const* const* strings = attrMap->getStringArray(STRING_ARRAY_KEY.c_str(), &stringsSize);
+	UT_StringArray stringValue;
+	for (size_t i = 0; i < stringsSize; i++)
+		stringValue.append(UT_StringHolder(toOSNarrowFromUTF16(strings[i])));
+
+	GA_RWHandleDA floatHandle(detail.findPrimitiveAttribute(NameConversion::toPrimAttr(FLOAT_ARRAY_KEY)));
+	GA_RWHandleSA stringHandle(detail.findPrimitiveAttribute(NameConversion::toPrimAttr(STRING_ARRAY_KEY)));
+	for (GA_Offset off = rangeStart; off < rangeStart + ATTRIBUTE_PRIMITIVES; off++) {
+		floatHandle.set(off, floatValue);
+		stringHandle.set(off, stringValue);
+	}
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	const std::vector<std::filesystem::path> addExtDirs = {TEST_RUN_PRT_EXT_DIR, TEST_RUN_CODEC_EXT_DIR};
+	prtCtx.reset(new PRTContext(addExtDirs));
+	int result = Catch::Session().run(argc, argv);
+	prtCtx.reset();
+	return result;
+}
+
+TEST_CASE("bridge holes vs. build holes", "[holes]") {
+	const std::vector<std::filesystem::path> initialShapeSources = {testDataPath / "holes" /
+	                                                                "example_bad_triang.usdexport1.usd"};
+	const std::vector<std::wstring> initialShapeURIs = {toFileURI(initialShapeSources[0])};
+	const std::vector<std::wstring> startRules = {L"Default$Shape"};
+	const std::filesystem::path rpkPath = testDataPath / "holes" / "do_cleanup.rpk";
+	const std::wstring ruleFile = L"bin/do_cleanup.cgb";
+
+	TestCallbacks tc;
+	generate(tc, prtCtx, rpkPath, ruleFile, initialShapeURIs, startRules, false);
+	REQUIRE(tc.results.size() == 1);
+	const CallbackResult& cr = *tc.results[0];
+
+	// both end up with the holes merged into their faces
+	REQUIRE(convertHoles(cr, false) == convertHoles(cr, true));
+
+	BENCHMARK("buildHoles") {
+		return convertHoles(cr, false);
+	};
+
+	BENCHMARK("bridgeHoles") {
+		return convertHoles(cr, true);
+	};
+}
+
+TEST_CASE("fill array attributes vs. set array attributes per primitive", "[attributes]") {
+	GU_Detail detail;
+	const GA_Offset rangeStart = detail.appendPrimitiveBlock(GA_PRIMPOLY, ATTRIBUTE_PRIMITIVES);
+	const AttributeMapUPtr attrMap = createArrayAttributes();
+
+	// the first conversion creates and binds the attributes, the runs below only write the values
+	AttributeConversion::ToHoudini toHoudini(&detail);
+	toHoudini.convert(attrMap.get(), rangeStart, ATTRIBUTE_PRIMITIVES,
+	                  AttributeConversion::ToHoudini::ArrayHandling::ARRAY);
+
+	GA_ROHandleDA floatHandle(detail.findPrimitiveAttribute(NameConversion::toPrimAttr(FLOAT_ARRAY_KEY)));
+	GA_ROHandleSA stringHandle(detail.findPrimitiveAttribute(NameConversion::toPrimAttr(STRING_ARRAY_KEY)));
+	REQUIRE(floatHandle.isValid());
+	REQUIRE(stringHandle.isValid());
+	const GA_Offset rangeLast = rangeStart + ATTRIBUTE_PRIMITIVES - 1;
+	UT_Fpreal64Array floats;
+	floatHandle.get(rangeLast, floats);
+	CHECK(floats.size() == ATTRIBUTE_ARRAY_SIZE);
+	CHECK(floats.last() == 0.5 * (ATTRIBUTE_ARRAY_SIZE - 1));
+	UT_StringArray strings;
+	stringHandle.get(rangeLast, strings);
+	CHECK(strings.size() == ATTRIBUTE_ARRAY_SIZE);
+	CHECK(strings.last().toStdString() == "value" + std::to_string(ATTRIBUTE_ARRAY_SIZE - 1));
+
+	BENCHMARK("fillHandleRange") {
+		toHoudini.convert(attrMap.get(), rangeStart, ATTRIBUTE_PRIMITIVES,
+		                  AttributeConversion::ToHoudini::ArrayHandling::ARRAY);
+	};
+
+	BENCHMARK("set per primitive") {
+		setArrayAttributesPerPrimitive(detail, attrMap.get(), rangeStart);
+	};
+}
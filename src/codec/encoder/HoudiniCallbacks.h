@@ -23,12 +23,15 @@ constexpr const wchar_t* EO_EMIT_ATTRIBUTES = L"emitAttributes";
 constexpr const wchar_t* EO_EMIT_MATERIALS = L"emitMaterials";
 constexpr const wchar_t* EO_EMIT_REPORTS = L"emitReports";
 constexpr const wchar_t* EO_TRIANGULATE_FACES_WITH_HOLES = L"triangulateFacesWithHoles";
+constexpr const wchar_t* EO_INSTANCING = L"instancing";
+constexpr const wchar_t* EO_MERGE_MESHES = L"mergeMeshes";
 
 class HoudiniCallbacks : public prt::Callbacks {
 public:
 	virtual ~HoudiniCallbacks() override = default;
 
 	/**
+	 * @param isIndex index of the initial shape in the array passed to the generate call
 	 * @param name initial shape (primitive group) name, optionally used to create primitive groups on output
 	 * @param vtx vertex coordinate array
 	 * @param length of vertex coordinate array
@@ -57,10 +60,11 @@ public:
 	 * @param reports contains faceRangesSize-1 attribute maps
 	 * @param shapeIDs shape ids per face, contains faceRangesSize-1 values
 	 */
-	virtual void add(const wchar_t* name, const double* vtx, size_t vtxSize, const double* nrm, size_t nrmSize,
-	                 const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
-	                 const uint32_t* holeIndices, size_t holeIndicesSize, const uint32_t* vertexIndices,
-	                 size_t vertexIndicesSize, const uint32_t* normalIndices, size_t normalIndicesSize,
+	virtual void add(size_t isIndex, const wchar_t* name, const double* vtx, size_t vtxSize, const double* nrm,
+	                 size_t nrmSize, const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts,
+	                 size_t holeCountsSize, const uint32_t* holeIndices, size_t holeIndicesSize,
+	                 const uint32_t* vertexIndices, size_t vertexIndicesSize, const uint32_t* normalIndices,
+	                 size_t normalIndicesSize,
 
 	                 double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
 	                 size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
@@ -68,4 +72,37 @@ public:
 
 	                 const uint32_t* faceRanges, size_t faceRangesSize, const prt::AttributeMap** materials,
 	                 const prt::AttributeMap** reports, const int32_t* shapeIDs) = 0;
+
+	/**
+	 * instancing only: geometry which is inserted more than once into an initial shape, in its own coordinate system.
+	 * Called before the first addInstances call which refers to it, might be called again for the same key.
+	 * @param prototypeKey content hash of the geometry and materials, identifies the prototype across initial shapes
+	 * (all other parameters as for add)
+	 */
+	virtual void addPrototype(uint64_t prototypeKey, const double* vtx, size_t vtxSize, const double* nrm,
+	                          size_t nrmSize, const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts,
+	                          size_t holeCountsSize, const uint32_t* holeIndices, size_t holeIndicesSize,
+	                          const uint32_t* vertexIndices, size_t vertexIndicesSize, const uint32_t* normalIndices,
+	                          size_t normalIndicesSize,
+
+	                          double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
+	                          size_t const* uvCountsSizes, uint32_t const* const* uvIndices,
+	                          size_t const* uvIndicesSizes, uint32_t uvSets,
+
+	                          const uint32_t* faceRanges, size_t faceRangesSize,
+	                          const prt::AttributeMap** materials) = 0;
+
+	/**
+	 * instancing only: places a prototype several times into an initial shape
+	 * @param isIndex index of the initial shape in the array passed to the generate call
+	 * @param name initial shape (primitive group) name, optionally used to create primitive groups on output
+	 * @param prototypeKey key of a prototype passed to addPrototype before
+	 * @param transformations 16 values per instance, the column-major matrix from prototype to world coordinates
+	 * @param instancesSize number of instances
+	 * @param reports optional, contains instancesSize attribute maps
+	 * @param shapeIDs shape id per instance, contains instancesSize values
+	 */
+	virtual void addInstances(size_t isIndex, const wchar_t* name, uint64_t prototypeKey,
+	                          const double* transformations, size_t instancesSize,
+	                          const prt::AttributeMap** reports, const int32_t* shapeIDs) = 0;
 };
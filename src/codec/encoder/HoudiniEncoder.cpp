@@ -17,6 +17,8 @@
 #include "HoudiniEncoder.h"
 #include "HoudiniCallbacks.h"
 
+#include "../../palladio/ContentHash.h"
+
 #include "prtx/Attributable.h"
 #include "prtx/Exception.h"
 #include "prtx/ExtensionManager.h"
@@ -34,8 +36,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <memory>
 #include <numeric>
 #include <set>
@@ -372,6 +376,34 @@ uint32_t scanValidTextures(const prtx::MaterialPtr& mat) {
 const prtx::DoubleVector EMPTY_UVS;
 const prtx::IndexVector EMPTY_IDX;
 
+const prtx::DoubleVector IDENTITY_TRANSFORMATION = {1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0,
+                                                    0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0};
+
+const prtx::DoubleVector& getTransformation(const prtx::EncodePreparator::FinalizedInstance& instance) {
+	const prtx::DoubleVector& t = instance.getTransformation();
+	return (t.size() == 16) ? t : IDENTITY_TRANSFORMATION;
+}
+
+// a collision would only show the wrong prototype
+uint64_t getPrototypeKey(const detail::SerializedGeometry& sg, const AttributeMapNOPtrVector& materials) {
+	ContentHash hash;
+	hash.add(sg.coords);
+	hash.add(sg.normals);
+	hash.add(sg.counts);
+	hash.add(sg.holeCounts);
+	hash.add(sg.holeIndices);
+	hash.add(sg.vertexIndices);
+	hash.add(sg.normalIndices);
+	for (size_t uvSet = 0; uvSet < sg.uvs.size(); uvSet++) {
+		hash.add(sg.uvs[uvSet]);
+		hash.add(sg.uvCounts[uvSet]);
+		hash.add(sg.uvIndices[uvSet]);
+	}
+	for (const prt::AttributeMap* m : materials)
+		hash.add(m);
+	return hash.get();
+}
+
 } // namespace
 
 namespace detail {
@@ -501,6 +533,98 @@ SerializedGeometry serializeGeometry(const prtx::GeometryPtrVector& geometries,
 	return sg;
 }
 
+void transformGeometry(SerializedGeometry& sg, const prtx::GeometryPtrVector& geometries,
+                       const std::vector<prtx::DoubleVector>& transformations) {
+	assert(geometries.size() == transformations.size());
+
+	// the normals are only reversed together with the vertices if each vertex has its normal
+	const bool hasVertexNormals = (sg.normalIndices.size() == sg.vertexIndices.size());
+
+	size_t coordPos = 0;
+	size_t normalPos = 0;
+	size_t facePos = 0;
+	size_t vertexIndexPos = 0;
+	std::vector<size_t> uvIndexPos(sg.uvs.size(), 0);
+	for (size_t gi = 0; gi < geometries.size(); gi++) {
+		size_t numCoords = 0;
+		size_t numNormalCoords = 0;
+		size_t numFaces = 0;
+		for (const auto& mesh : geometries[gi]->getMeshes()) {
+			numCoords += mesh->getVertexCoords().size();
+			numNormalCoords += mesh->getVertexNormalsCoords().size();
+			numFaces += mesh->getFaceCount();
+		}
+
+		// column-major, i.e. m[c * 4 + r] is the value in row r and column c
+		const prtx::DoubleVector& t = transformations[gi];
+		const prtx::DoubleVector& m = (t.size() == 16) ? t : IDENTITY_TRANSFORMATION;
+
+		for (size_t ci = coordPos; ci + 2 < coordPos + numCoords; ci += 3) {
+			const double x = sg.coords[ci + 0];
+			const double y = sg.coords[ci + 1];
+			const double z = sg.coords[ci + 2];
+			sg.coords[ci + 0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+			sg.coords[ci + 1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+			sg.coords[ci + 2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+		}
+
+		// normals are transformed by the inverse transpose, i.e. the cofactor matrix divided by the determinant
+		const double c00 = m[5] * m[10] - m[9] * m[6];
+		const double c01 = m[9] * m[2] - m[1] * m[10];
+		const double c02 = m[1] * m[6] - m[5] * m[2];
+		const double c10 = m[8] * m[6] - m[4] * m[10];
+		const double c11 = m[0] * m[10] - m[8] * m[2];
+		const double c12 = m[4] * m[2] - m[0] * m[6];
+		const double c20 = m[4] * m[9] - m[8] * m[5];
+		const double c21 = m[8] * m[1] - m[0] * m[9];
+		const double c22 = m[0] * m[5] - m[4] * m[1];
+		const double det = m[0] * c00 + m[4] * c01 + m[8] * c02;
+		const double sign = (det < 0.0) ? -1.0 : 1.0;
+		for (size_t ni = normalPos; ni + 2 < normalPos + numNormalCoords; ni += 3) {
+			const double x = sg.normals[ni + 0];
+			const double y = sg.normals[ni + 1];
+			const double z = sg.normals[ni + 2];
+			const double tx = sign * (c00 * x + c01 * y + c02 * z);
+			const double ty = sign * (c10 * x + c11 * y + c12 * z);
+			const double tz = sign * (c20 * x + c21 * y + c22 * z);
+			const double length = std::sqrt(tx * tx + ty * ty + tz * tz);
+			if (length > 0.0) {
+				sg.normals[ni + 0] = tx / length;
+				sg.normals[ni + 1] = ty / length;
+				sg.normals[ni + 2] = tz / length;
+			}
+		}
+
+		// a mirroring transformation turns the faces inside out
+		const bool mirrors = (det < 0.0);
+		for (size_t fi = facePos; fi < facePos + numFaces; fi++) {
+			const uint32_t count = sg.counts[fi];
+			if (mirrors) {
+				std::reverse(sg.vertexIndices.begin() + vertexIndexPos,
+				             sg.vertexIndices.begin() + vertexIndexPos + count);
+				if (hasVertexNormals)
+					std::reverse(sg.normalIndices.begin() + vertexIndexPos,
+					             sg.normalIndices.begin() + vertexIndexPos + count);
+			}
+			vertexIndexPos += count;
+
+			for (size_t uvSet = 0; uvSet < sg.uvs.size(); uvSet++) {
+				const uint32_t uvCount = sg.uvCounts[uvSet][fi];
+				if (mirrors) {
+					auto& uvIndices = sg.uvIndices[uvSet];
+					std::reverse(uvIndices.begin() + uvIndexPos[uvSet],
+					             uvIndices.begin() + uvIndexPos[uvSet] + uvCount);
+				}
+				uvIndexPos[uvSet] += uvCount;
+			}
+		}
+
+		coordPos += numCoords;
+		normalPos += numNormalCoords;
+		facePos += numFaces;
+	}
+}
+
 } // namespace detail
 
 HoudiniEncoder::HoudiniEncoder(const std::wstring& id, const prt::AttributeMap* options, prt::Callbacks* callbacks)
@@ -543,11 +667,13 @@ void HoudiniEncoder::encode(prtx::GenerateContext& context, size_t initialShapeI
 	}
 
 	const bool triangulateFacesWithHoles = getOptions()->getBool(EO_TRIANGULATE_FACES_WITH_HOLES);
+	const bool instancing = getOptions()->getBool(EO_INSTANCING);
+	const bool mergeMeshes = getOptions()->getBool(EO_MERGE_MESHES);
 
 	const prtx::EncodePreparator::PreparationFlags encodePreparatorFlags =
 	        prtx::EncodePreparator::PreparationFlags()
-	                .instancing(false)
-	                .meshMerging(prtx::MeshMerging::NONE)
+	                .instancing(instancing)
+	                .meshMerging(mergeMeshes ? prtx::MeshMerging::MERGE_BY_MATERIAL : prtx::MeshMerging::NONE)
 	                .triangulate(false)
 	                .processHoles(triangulateFacesWithHoles ? prtx::HoleProcessor::TRIANGULATE_FACES_WITH_HOLES
 	                                                        : prtx::HoleProcessor::PASS)
@@ -559,11 +685,119 @@ void HoudiniEncoder::encode(prtx::GenerateContext& context, size_t initialShapeI
 
 	prtx::EncodePreparator::InstanceVector instances;
 	encPrep->fetchFinalizedInstances(instances, encodePreparatorFlags);
-	convertGeometry(initialShape, instances, cb);
+	if (instancing) {
+		// the geometry of the remaining instances is still in prototype coordinates
+		const prtx::EncodePreparator::InstanceVector remaining =
+		        convertPrototypes(initialShapeIndex, initialShape, instances, cb);
+		convertGeometry(initialShapeIndex, initialShape, remaining, cb, true);
+	}
+	else
+		convertGeometry(initialShapeIndex, initialShape, instances, cb, false);
 }
 
-void HoudiniEncoder::convertGeometry(const prtx::InitialShape& initialShape,
-                                     const prtx::EncodePreparator::InstanceVector& instances, HoudiniCallbacks* cb) {
+const prt::AttributeMap* HoudiniEncoder::getMaterialAttributeMap(const prtx::MaterialPtr& material) {
+	auto it = mMaterialAttributeMaps.find(material);
+	if (it == mMaterialAttributeMaps.end()) {
+		prtx::PRTUtils::AttributeMapBuilderPtr amb(prt::AttributeMapBuilder::create());
+		convertMaterialToAttributeMap(amb, *material, material->getKeys());
+		it = mMaterialAttributeMaps.emplace(material, AttributeMapUPtr(amb->createAttributeMap())).first;
+	}
+	return it->second.get();
+}
+
+prtx::EncodePreparator::InstanceVector
+HoudiniEncoder::convertPrototypes(size_t initialShapeIndex, const prtx::InitialShape& initialShape,
+                                  const prtx::EncodePreparator::InstanceVector& instances, HoudiniCallbacks* cb) {
+	const bool emitMaterials = getOptions()->getBool(EO_EMIT_MATERIALS);
+	const bool emitReports = getOptions()->getBool(EO_EMIT_REPORTS);
+
+	// instances of the same prototype might still differ in their materials
+	using PrototypeKey = std::pair<int32_t, std::vector<const prtx::Material*>>;
+	auto getKey = [emitMaterials](const prtx::EncodePreparator::FinalizedInstance& inst) {
+		PrototypeKey key{inst.getPrototypeIndex(), {}};
+		if (emitMaterials) {
+			for (const prtx::MaterialPtr& mat : inst.getMaterials())
+				key.second.push_back(mat.get());
+		}
+		return key;
+	};
+
+	std::map<PrototypeKey, std::vector<const prtx::EncodePreparator::FinalizedInstance*>> prototypeInstances;
+	for (const auto& inst : instances)
+		prototypeInstances[getKey(inst)].push_back(&inst);
+
+	// keep the order of the instances, a prototype is reported at its first instance
+	prtx::EncodePreparator::InstanceVector remaining;
+	std::vector<const std::vector<const prtx::EncodePreparator::FinalizedInstance*>*> prototypes;
+	for (const auto& inst : instances) {
+		const auto& pis = prototypeInstances.at(getKey(inst));
+		if (pis.size() < 2)
+			remaining.push_back(inst);
+		else if (pis.front() == &inst)
+			prototypes.push_back(&pis);
+	}
+
+	prtx::PRTUtils::AttributeMapBuilderPtr amb(prt::AttributeMapBuilder::create());
+	for (const auto* pis : prototypes) {
+		const prtx::EncodePreparator::FinalizedInstance& first = *pis->front();
+		const prtx::GeometryPtr& geo = first.getGeometry();
+		const prtx::MaterialPtrVector& mats = first.getMaterials();
+		const detail::SerializedGeometry sg = detail::serializeGeometry({geo}, {mats});
+
+		uint32_t faceCount = 0;
+		std::vector<uint32_t> faceRanges;
+		AttributeMapNOPtrVector matAttrMaps; // owned by mMaterialAttributeMaps
+		const prtx::MeshPtrVector& meshes = geo->getMeshes();
+		for (size_t mi = 0; mi < meshes.size(); mi++) {
+			faceRanges.push_back(faceCount);
+			if (emitMaterials)
+				matAttrMaps.push_back(getMaterialAttributeMap(mats.at(mi)));
+			faceCount += meshes[mi]->getFaceCount();
+		}
+		faceRanges.push_back(faceCount); // close last range
+
+		const uint64_t prototypeKey = getPrototypeKey(sg, matAttrMaps);
+		if (mReportedPrototypes.insert(prototypeKey).second) {
+			auto puvs = toPtrVec(sg.uvs);
+			auto puvCounts = toPtrVec(sg.uvCounts);
+			auto puvIndices = toPtrVec(sg.uvIndices);
+			cb->addPrototype(prototypeKey, sg.coords.data(), sg.coords.size(), sg.normals.data(), sg.normals.size(),
+			                 sg.counts.data(), sg.counts.size(), sg.holeCounts.data(), sg.holeCounts.size(),
+			                 sg.holeIndices.data(), sg.holeIndices.size(), sg.vertexIndices.data(),
+			                 sg.vertexIndices.size(), sg.normalIndices.data(), sg.normalIndices.size(),
+
+			                 puvs.first.data(), puvs.second.data(), puvCounts.first.data(), puvCounts.second.data(),
+			                 puvIndices.first.data(), puvIndices.second.data(), static_cast<uint32_t>(sg.uvs.size()),
+
+			                 faceRanges.data(), faceRanges.size(),
+			                 matAttrMaps.empty() ? nullptr : matAttrMaps.data());
+		}
+
+		std::vector<double> transformations;
+		transformations.reserve(16 * pis->size());
+		AttributeMapNOPtrVectorOwner reportAttrMaps;
+		std::vector<int32_t> shapeIDs;
+		shapeIDs.reserve(pis->size());
+		for (const auto* inst : *pis) {
+			const prtx::DoubleVector& t = getTransformation(*inst);
+			transformations.insert(transformations.end(), t.begin(), t.end());
+			if (emitReports) {
+				convertReportsToAttributeMap(amb, inst->getReports());
+				reportAttrMaps.v.push_back(amb->createAttributeMapAndReset());
+			}
+			shapeIDs.push_back(inst->getShapeId());
+		}
+
+		cb->addInstances(initialShapeIndex, initialShape.getName(), prototypeKey, transformations.data(), pis->size(),
+		                 reportAttrMaps.v.empty() ? nullptr : reportAttrMaps.v.data(), shapeIDs.data());
+	}
+
+	return remaining;
+}
+
+void HoudiniEncoder::convertGeometry(size_t initialShapeIndex, const prtx::InitialShape& initialShape,
+                                     const prtx::EncodePreparator::InstanceVector& instances, HoudiniCallbacks* cb,
+                                     bool transformInstances) {
 	const bool emitMaterials = getOptions()->getBool(EO_EMIT_MATERIALS);
 	const bool emitReports = getOptions()->getBool(EO_EMIT_REPORTS);
 
@@ -584,7 +818,14 @@ void HoudiniEncoder::convertGeometry(const prtx::InitialShape& initialShape,
 		shapeIDs.push_back(inst.getShapeId());
 	}
 
-	const detail::SerializedGeometry sg = detail::serializeGeometry(geometries, materials);
+	detail::SerializedGeometry sg = detail::serializeGeometry(geometries, materials);
+	if (transformInstances) {
+		std::vector<prtx::DoubleVector> transformations;
+		transformations.reserve(instances.size());
+		for (const auto& inst : instances)
+			transformations.push_back(getTransformation(inst));
+		detail::transformGeometry(sg, geometries, transformations);
+	}
 
 	if (DBG) {
 		log_debug("resolvemap: %s") % prtx::PRTUtils::objectToXML(initialShape.getResolveMap());
@@ -593,7 +834,7 @@ void HoudiniEncoder::convertGeometry(const prtx::InitialShape& initialShape,
 
 	uint32_t faceCount = 0;
 	std::vector<uint32_t> faceRanges;
-	AttributeMapNOPtrVectorOwner matAttrMaps;
+	AttributeMapNOPtrVector matAttrMaps; // owned by mMaterialAttributeMaps
 	AttributeMapNOPtrVectorOwner reportAttrMaps;
 
 	assert(geometries.size() == reports.size());
@@ -610,10 +851,8 @@ void HoudiniEncoder::convertGeometry(const prtx::InitialShape& initialShape,
 
 			faceRanges.push_back(faceCount);
 
-			if (emitMaterials) {
-				convertMaterialToAttributeMap(amb, *(mat.get()), mat->getKeys());
-				matAttrMaps.v.push_back(amb->createAttributeMapAndReset());
-			}
+			if (emitMaterials)
+				matAttrMaps.push_back(getMaterialAttributeMap(mat));
 
 			if (emitReports) {
 				convertReportsToAttributeMap(amb, *repIt);
@@ -630,7 +869,7 @@ void HoudiniEncoder::convertGeometry(const prtx::InitialShape& initialShape,
 	}
 	faceRanges.push_back(faceCount); // close last range
 
-	assert(matAttrMaps.v.empty() || matAttrMaps.v.size() == faceRanges.size() - 1);
+	assert(matAttrMaps.empty() || matAttrMaps.size() == faceRanges.size() - 1);
 	assert(reportAttrMaps.v.empty() || reportAttrMaps.v.size() == faceRanges.size() - 1);
 	assert(shapeIDs.size() == faceRanges.size() - 1);
 
@@ -644,15 +883,15 @@ void HoudiniEncoder::convertGeometry(const prtx::InitialShape& initialShape,
 	assert(sg.uvs.size() == puvCounts.first.size());
 	assert(sg.uvs.size() == puvCounts.second.size());
 
-	cb->add(initialShape.getName(), sg.coords.data(), sg.coords.size(), sg.normals.data(), sg.normals.size(),
-	        sg.counts.data(), sg.counts.size(), sg.holeCounts.data(), sg.holeCounts.size(), sg.holeIndices.data(),
-	        sg.holeIndices.size(), sg.vertexIndices.data(), sg.vertexIndices.size(), sg.normalIndices.data(),
-	        sg.normalIndices.size(),
+	cb->add(initialShapeIndex, initialShape.getName(), sg.coords.data(), sg.coords.size(), sg.normals.data(),
+	        sg.normals.size(), sg.counts.data(), sg.counts.size(), sg.holeCounts.data(), sg.holeCounts.size(),
+	        sg.holeIndices.data(), sg.holeIndices.size(), sg.vertexIndices.data(), sg.vertexIndices.size(),
+	        sg.normalIndices.data(), sg.normalIndices.size(),
 
 	        puvs.first.data(), puvs.second.data(), puvCounts.first.data(), puvCounts.second.data(),
 	        puvIndices.first.data(), puvIndices.second.data(), static_cast<uint32_t>(sg.uvs.size()),
 
-	        faceRanges.data(), faceRanges.size(), matAttrMaps.v.empty() ? nullptr : matAttrMaps.v.data(),
+	        faceRanges.data(), faceRanges.size(), matAttrMaps.empty() ? nullptr : matAttrMaps.data(),
 	        reportAttrMaps.v.empty() ? nullptr : reportAttrMaps.v.data(), shapeIDs.data());
 
 	if (DBG)
@@ -674,6 +913,8 @@ HoudiniEncoderFactory* HoudiniEncoderFactory::createInstance() {
 	amb->setBool(EO_EMIT_MATERIALS, prtx::PRTX_FALSE);
 	amb->setBool(EO_EMIT_REPORTS, prtx::PRTX_FALSE);
 	amb->setBool(EO_TRIANGULATE_FACES_WITH_HOLES, prtx::PRTX_TRUE);
+	amb->setBool(EO_INSTANCING, prtx::PRTX_FALSE);
+	amb->setBool(EO_MERGE_MESHES, prtx::PRTX_FALSE);
 	encoderInfoBuilder.setDefaultOptions(amb->createAttributeMap());
 
 	return new HoudiniEncoderFactory(encoderInfoBuilder.create());
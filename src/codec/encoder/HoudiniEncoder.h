@@ -31,8 +31,11 @@
 #include "prt/InitialShape.h"
 
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 class HoudiniCallbacks;
 
@@ -68,6 +71,11 @@ struct SerializedGeometry {
 CODEC_EXPORTS_API SerializedGeometry serializeGeometry(const prtx::GeometryPtrVector& geometries,
                                                        const std::vector<prtx::MaterialPtrVector>& materials);
 
+// moves the serialized geometries from their prototype into world coordinates, transformations holds one column-major
+// 4x4 matrix per geometry (mirroring matrices also reverse the winding), visible for tests
+CODEC_EXPORTS_API void transformGeometry(SerializedGeometry& sg, const prtx::GeometryPtrVector& geometries,
+                                         const std::vector<prtx::DoubleVector>& transformations);
+
 } // namespace detail
 
 class HoudiniEncoder : public prtx::GeometryEncoder {
@@ -81,8 +89,31 @@ public:
 	void finish(prtx::GenerateContext& context) override;
 
 private:
-	void convertGeometry(const prtx::InitialShape& initialShape,
-	                     const prtx::EncodePreparator::InstanceVector& instances, HoudiniCallbacks* callbacks);
+	void convertGeometry(size_t initialShapeIndex, const prtx::InitialShape& initialShape,
+	                     const prtx::EncodePreparator::InstanceVector& instances, HoudiniCallbacks* callbacks,
+	                     bool transformInstances);
+
+	// reports the geometries used by more than one instance as prototypes, returns the remaining instances
+	prtx::EncodePreparator::InstanceVector convertPrototypes(size_t initialShapeIndex,
+	                                                         const prtx::InitialShape& initialShape,
+	                                                         const prtx::EncodePreparator::InstanceVector& instances,
+	                                                         HoudiniCallbacks* callbacks);
+
+	// converts each material only once per encoder, the attribute map stays owned by the encoder
+	const prt::AttributeMap* getMaterialAttributeMap(const prtx::MaterialPtr& material);
+
+	// the keys of the prototypes already passed to the callbacks (an encoder instance is never shared between threads)
+	std::unordered_set<uint64_t> mReportedPrototypes;
+
+	struct AttributeMapDestroyer {
+		void operator()(const prt::AttributeMap* attributeMap) const {
+			attributeMap->destroy();
+		}
+	};
+	using AttributeMapUPtr = std::unique_ptr<const prt::AttributeMap, AttributeMapDestroyer>;
+
+	// the converted materials, the keys keep the materials alive, i.e. their identity is never reused
+	std::unordered_map<prtx::MaterialPtr, AttributeMapUPtr> mMaterialAttributeMaps;
 };
 
 class HoudiniEncoderFactory : public prtx::EncoderFactory, public prtx::Singleton<HoudiniEncoderFactory> {
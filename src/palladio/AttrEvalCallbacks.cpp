@@ -73,24 +73,24 @@ prt::Status AttrEvalCallbacks::cgaReportString(size_t isIndex, int32_t shapeID,
 prt::Status AttrEvalCallbacks::attrBool(size_t isIndex, int32_t shapeID, const wchar_t* key, bool value) {
 	if (DBG)
 		LOG_DBG << "attrBool: isIndex = " << isIndex << ", key = " << key << " = " << value;
-	if (mRuleFileInfo[isIndex] && !isHiddenAttribute(mRuleFileInfo[isIndex], key))
-		mAMBS[isIndex]->setBool(key, value);
+	if (mRuleFileInfo[mISIndexOffset + isIndex] && !isHiddenAttribute(mRuleFileInfo[mISIndexOffset + isIndex], key))
+		mAMBS[mISIndexOffset + isIndex]->setBool(key, value);
 	return prt::STATUS_OK;
 }
 
 prt::Status AttrEvalCallbacks::attrFloat(size_t isIndex, int32_t shapeID, const wchar_t* key, double value) {
 	if (DBG)
 		LOG_DBG << "attrFloat: isIndex = " << isIndex << ", key = " << key << " = " << value;
-	if (mRuleFileInfo[isIndex] && !isHiddenAttribute(mRuleFileInfo[isIndex], key))
-		mAMBS[isIndex]->setFloat(key, value);
+	if (mRuleFileInfo[mISIndexOffset + isIndex] && !isHiddenAttribute(mRuleFileInfo[mISIndexOffset + isIndex], key))
+		mAMBS[mISIndexOffset + isIndex]->setFloat(key, value);
 	return prt::STATUS_OK;
 }
 
 prt::Status AttrEvalCallbacks::attrString(size_t isIndex, int32_t shapeID, const wchar_t* key, const wchar_t* value) {
 	if (DBG)
 		LOG_DBG << "attrString: isIndex = " << isIndex << ", key = " << key << " = " << value;
-	if (mRuleFileInfo[isIndex] && !isHiddenAttribute(mRuleFileInfo[isIndex], key))
-		mAMBS[isIndex]->setString(key, value);
+	if (mRuleFileInfo[mISIndexOffset + isIndex] && !isHiddenAttribute(mRuleFileInfo[mISIndexOffset + isIndex], key))
+		mAMBS[mISIndexOffset + isIndex]->setString(key, value);
 	return prt::STATUS_OK;
 }
 
@@ -100,8 +100,8 @@ prt::Status AttrEvalCallbacks::attrBoolArray(size_t isIndex, int32_t /*shapeID*/
                                              const bool* values, size_t size, size_t /*nRows*/) {
 	if (DBG)
 		LOG_DBG << "attrBoolArray: isIndex = " << isIndex << ", key = " << key << " = " << values;
-	if (mRuleFileInfo[isIndex] && !isHiddenAttribute(mRuleFileInfo[isIndex], key))
-		mAMBS[isIndex]->setBoolArray(key, values, size);
+	if (mRuleFileInfo[mISIndexOffset + isIndex] && !isHiddenAttribute(mRuleFileInfo[mISIndexOffset + isIndex], key))
+		mAMBS[mISIndexOffset + isIndex]->setBoolArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
@@ -109,8 +109,8 @@ prt::Status AttrEvalCallbacks::attrFloatArray(size_t isIndex, int32_t /*shapeID*
                                               const double* values, size_t size, size_t /*nRows*/) {
 	if (DBG)
 		LOG_DBG << "attrFloatArray: isIndex = " << isIndex << ", key = " << key << " = " << values;
-	if (mRuleFileInfo[isIndex] && !isHiddenAttribute(mRuleFileInfo[isIndex], key))
-		mAMBS[isIndex]->setFloatArray(key, values, size);
+	if (mRuleFileInfo[mISIndexOffset + isIndex] && !isHiddenAttribute(mRuleFileInfo[mISIndexOffset + isIndex], key))
+		mAMBS[mISIndexOffset + isIndex]->setFloatArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
@@ -118,8 +118,8 @@ prt::Status AttrEvalCallbacks::attrStringArray(size_t isIndex, int32_t /*shapeID
                                                const wchar_t* const* values, size_t size, size_t /*nRows*/) {
 	if (DBG)
 		LOG_DBG << "attrStringArray: isIndex = " << isIndex << ", key = " << key << " = " << values;
-	if (mRuleFileInfo[isIndex] && !isHiddenAttribute(mRuleFileInfo[isIndex], key))
-		mAMBS[isIndex]->setStringArray(key, values, size);
+	if (mRuleFileInfo[mISIndexOffset + isIndex] && !isHiddenAttribute(mRuleFileInfo[mISIndexOffset + isIndex], key))
+		mAMBS[mISIndexOffset + isIndex]->setStringArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
@@ -129,8 +129,8 @@ prt::Status AttrEvalCallbacks::attrBoolArray(size_t isIndex, int32_t /*shapeID*/
                                              const bool* values, size_t size) {
 	if (DBG)
 		LOG_DBG << "attrBoolArray: isIndex = " << isIndex << ", key = " << key << " = " << values;
-	if (mRuleFileInfo[isIndex] && !isHiddenAttribute(mRuleFileInfo[isIndex], key))
-		mAMBS[isIndex]->setBoolArray(key, values, size);
+	if (mRuleFileInfo[mISIndexOffset + isIndex] && !isHiddenAttribute(mRuleFileInfo[mISIndexOffset + isIndex], key))
+		mAMBS[mISIndexOffset + isIndex]->setBoolArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
@@ -138,8 +138,8 @@ prt::Status AttrEvalCallbacks::attrFloatArray(size_t isIndex, int32_t /*shapeID*
                                               const double* values, size_t size) {
 	if (DBG)
 		LOG_DBG << "attrFloatArray: isIndex = " << isIndex << ", key = " << key << " = " << values;
-	if (mRuleFileInfo[isIndex] && !isHiddenAttribute(mRuleFileInfo[isIndex], key))
-		mAMBS[isIndex]->setFloatArray(key, values, size);
+	if (mRuleFileInfo[mISIndexOffset + isIndex] && !isHiddenAttribute(mRuleFileInfo[mISIndexOffset + isIndex], key))
+		mAMBS[mISIndexOffset + isIndex]->setFloatArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
@@ -147,8 +147,8 @@ prt::Status AttrEvalCallbacks::attrStringArray(size_t isIndex, int32_t /*shapeID
                                                const wchar_t* const* values, size_t size) {
 	if (DBG)
 		LOG_DBG << "attrStringArray: isIndex = " << isIndex << ", key = " << key << " = " << values;
-	if (mRuleFileInfo[isIndex] && !isHiddenAttribute(mRuleFileInfo[isIndex], key))
-		mAMBS[isIndex]->setStringArray(key, values, size);
+	if (mRuleFileInfo[mISIndexOffset + isIndex] && !isHiddenAttribute(mRuleFileInfo[mISIndexOffset + isIndex], key))
+		mAMBS[mISIndexOffset + isIndex]->setStringArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
@@ -24,8 +24,10 @@
 
 class AttrEvalCallbacks : public prt::Callbacks {
 public:
-	explicit AttrEvalCallbacks(AttributeMapBuilderVector& ambs, const std::vector<RuleFileInfoUPtr>& ruleFileInfo)
-	    : mAMBS(ambs), mRuleFileInfo(ruleFileInfo) {}
+	// isIndexOffset: position of the first initial shape passed to generate within ambs and ruleFileInfo
+	explicit AttrEvalCallbacks(AttributeMapBuilderVector& ambs, const std::vector<RuleFileInfoUPtr>& ruleFileInfo,
+	                           size_t isIndexOffset = 0)
+	    : mAMBS(ambs), mRuleFileInfo(ruleFileInfo), mISIndexOffset(isIndexOffset) {}
 	~AttrEvalCallbacks() override = default;
 
 	prt::Status generateError(size_t isIndex, prt::Status status, const wchar_t* message) override;
@@ -65,4 +67,5 @@ public:
 private:
 	AttributeMapBuilderVector& mAMBS;
 	const std::vector<RuleFileInfoUPtr>& mRuleFileInfo;
+	const size_t mISIndexOffset;
 };
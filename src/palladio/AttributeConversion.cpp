@@ -15,13 +15,16 @@
  */
 
 #include "AttributeConversion.h"
+#include "ContentHash.h"
 #include "LRUCache.h"
 #include "LogHandler.h"
 #include "MultiWatch.h"
 
 #include <bitset>
 #include <mutex>
+#include <type_traits>
 
+#include "GA/GA_AIFCopyData.h"
 #include "UT/UT_VarEncode.h"
 
 namespace {
@@ -61,31 +64,41 @@ void setHandleRange(const GA_IndexMap& indexMap, GA_RWHandleF& handle, GA_Offset
 }
 
 void setHandleRange(const GA_IndexMap& indexMap, GA_RWBatchHandleS& handle, GA_Offset start, GA_Size size,
-                    int component, const std::wstring& value) {
-	const UT_String attrValue = [&value]() {
-		const auto sh = StringConversionCaches::toPrimAttr.get(value);
-		if (sh)
-			return sh.value();
-		const std::string nv = toOSNarrowFromUTF16(value);
-		UT_String hv(UT_String::ALWAYS_DEEP, nv); // ensure owning UT_String inside cache
-		StringConversionCaches::toPrimAttr.insert(value, hv);
-		return hv;
-	}();
-
+                    int component, const UT_StringHolder& value) {
 	const GA_Range range(indexMap, start, start + size);
-	handle.set(range, component, attrValue);
+	handle.set(range, component, value);
 
 	if (DBG)
 		LOG_DBG << "string attr: range = [" << start << ", " << start + size
-		        << "): " << handle.getAttribute()->getName() << " = " << attrValue;
+		        << "): " << handle.getAttribute()->getName() << " = " << value;
+}
+
+// sets the array value on the first primitive and lets the attribute copy it to the rest of the range (page-wise),
+// instead of converting and copying the array for each primitive
+template <typename H, typename A>
+void fillHandleRange(const GA_IndexMap& indexMap, H& handle, GA_Offset start, GA_Size size, const A& value) {
+	if (size <= 0)
+		return;
+
+	handle.set(start, value);
+	if (size == 1)
+		return;
+
+	GA_Attribute* attribute = handle.getAttribute();
+	const GA_AIFCopyData* copyData = attribute->getAIFCopyData();
+	const GA_Range range(indexMap, start + 1, start + size);
+	if (copyData != nullptr && copyData->fill(*attribute, range, *attribute, start))
+		return;
+
+	for (GA_Offset off = start + 1; off < start + size; off++)
+		handle.set(off, value);
 }
 
 void setHandleRange(const GA_IndexMap& indexMap, GA_RWHandleDA& handle, GA_Offset start, GA_Size size,
                     const double* ptr, size_t ptrSize) {
 	UT_Fpreal64Array hv;
 	hv.append(ptr, ptrSize);
-	for (GA_Offset off = start; off < start + size; off++)
-		handle.set(off, hv);
+	fillHandleRange(indexMap, handle, start, size, hv);
 	if (DBG)
 		LOG_DBG << "float array attr: range = [" << start << ", " << start + size
 		        << "): " << handle.getAttribute()->getName() << " = " << hv;
@@ -95,8 +108,7 @@ void setHandleRange(const GA_IndexMap& indexMap, GA_RWHandleIA& handle, GA_Offse
                     const int32_t* ptr, size_t ptrSize) {
 	UT_Int32Array hv;
 	hv.append(ptr, ptrSize);
-	for (GA_Offset off = start; off < start + size; off++)
-		handle.set(off, hv);
+	fillHandleRange(indexMap, handle, start, size, hv);
 	if (DBG)
 		LOG_DBG << "int array attr: range = [" << start << ", " << start + size
 		        << "): " << handle.getAttribute()->getName() << " = " << hv;
@@ -107,20 +119,15 @@ void setHandleRange(const GA_IndexMap& indexMap, GA_RWHandleIA& handle, GA_Offse
 	UT_IntArray hv(ptrSize, ptrSize); // there is no UT_Int8Array
 	for (size_t i = 0; i < ptrSize; i++)
 		hv[i] = ptr[i] ? 1u : 0u;
-	for (GA_Offset off = start; off < start + size; off++)
-		handle.set(off, hv);
+	fillHandleRange(indexMap, handle, start, size, hv);
 	if (DBG)
 		LOG_DBG << "bool array attr: range = [" << start << ", " << start + size
 		        << "): " << handle.getAttribute()->getName() << " = " << hv;
 }
 
 void setHandleRange(const GA_IndexMap& indexMap, GA_RWHandleSA& handle, GA_Offset start, GA_Size size,
-                    wchar_t const* const* ptr, size_t ptrSize) {
-	UT_StringArray hv(ptrSize, ptrSize);
-	for (size_t i = 0; i < ptrSize; i++)
-		hv[i] = UT_StringHolder(toOSNarrowFromUTF16(ptr[i]));
-	for (GA_Offset off = start; off < start + size; off++)
-		handle.set(off, hv);
+                    const UT_StringArray& hv) {
+	fillHandleRange(indexMap, handle, start, size, hv);
 	if (DBG)
 		LOG_DBG << "string array attr: range = [" << start << ", " << start + size
 		        << "): " << handle.getAttribute()->getName() << " = " << hv;
@@ -154,6 +161,20 @@ size_t getAttributeCardinality(const prt::AttributeMap* attrMap, const std::wstr
 	return cardinality;
 }
 
+// keys, types and cardinalities in key order, the values are not part of the schema
+uint64_t getSchemaKey(const prt::AttributeMap* attrMap, bool useArrayTypes) {
+	ContentHash hash;
+	hash.add(useArrayTypes);
+	size_t keyCount = 0;
+	wchar_t const* const* keys = attrMap->getKeys(&keyCount);
+	for (size_t k = 0; k < keyCount; k++) {
+		const std::wstring key(keys[k]);
+		const prt::Attributable::PrimitiveType type = attrMap->getType(key.c_str());
+		hash.add(key).add(static_cast<int32_t>(type)).add(getAttributeCardinality(attrMap, key, type));
+	}
+	return hash.get();
+}
+
 bool isArrayAttribute(const GA_ROAttributeRef& ar) {
 	return (ar.getAIFNumericArray() != nullptr) || (ar.getAIFSharedStringArray() != nullptr);
 }
@@ -162,6 +183,15 @@ bool isArrayAttribute(const GA_ROAttributeRef& ar) {
 
 namespace AttributeConversion {
 
+const UT_StringHolder& StringTable::get(const wchar_t* s) {
+	const auto it = mStrings.find(std::wstring_view(s));
+	if (it != mStrings.end())
+		return it->second;
+
+	const std::wstring& key = mKeys.emplace_back(s);
+	return mStrings.emplace(key, UT_StringHolder(toOSNarrowFromUTF16(key))).first->second;
+}
+
 bool FromHoudini::convert(const GA_ROAttributeRef& ar, const GA_Offset& offset, const std::wstring& name) {
 	if (isArrayAttribute(ar))
 		return handleArray(ar, offset, name);
@@ -294,12 +324,42 @@ bool FromHoudini::handleArray(const GA_ROAttributeRef& ar, const GA_Offset& offs
 void ToHoudini::convert(const prt::AttributeMap* attrMap, const GA_Offset rangeStart, const GA_Size rangeSize,
                         ArrayHandling arrayHandling) {
 	const GA_IndexMap& primIndexMap = mDetail->getIndexMap(GA_ATTRIB_PRIMITIVE);
-	extractAttributeNames(attrMap);
-	createAttributeHandles(arrayHandling == ArrayHandling::ARRAY);
-	setAttributeValues(attrMap, primIndexMap, rangeStart, rangeSize);
+	HandleMap& handleMap = getSchema(attrMap, arrayHandling == ArrayHandling::ARRAY);
+	setAttributeValues(handleMap, attrMap, primIndexMap, rangeStart, rangeSize);
 }
 
-void ToHoudini::extractAttributeNames(const prt::AttributeMap* attrMap) {
+ToHoudini::HandleMap& ToHoudini::getSchema(const prt::AttributeMap* attrMap, bool useArrayTypes) {
+	const uint64_t schemaKey = getSchemaKey(attrMap, useArrayTypes);
+	auto it = mSchemas.find(schemaKey);
+	if (it != mSchemas.end() && isBound(it->second))
+		return it->second;
+
+	HandleMap& handleMap = mSchemas[schemaKey];
+	handleMap.clear();
+	extractAttributeNames(handleMap, attrMap);
+	createAttributeHandles(handleMap, useArrayTypes);
+	if (DBG)
+		LOG_DBG << "bound attribute schema " << schemaKey << " with " << handleMap.size() << " handles";
+	return handleMap;
+}
+
+// the attributes might have been replaced meanwhile, e.g. by another converter writing into the same detail
+bool ToHoudini::isBound(const HandleMap& handleMap) const {
+	const auto getAttribute = [](const auto& handle) -> const GA_Attribute* {
+		if constexpr (std::is_same_v<std::decay_t<decltype(handle)>, NoHandle>)
+			return nullptr;
+		else
+			return handle.getAttribute();
+	};
+	for (const auto& hm : handleMap) {
+		const GA_Attribute* attribute = std::visit(getAttribute, hm.second.handleType);
+		if (attribute != nullptr && attribute != mDetail->findPrimitiveAttribute(hm.first))
+			return false;
+	}
+	return true;
+}
+
+void ToHoudini::extractAttributeNames(HandleMap& handleMap, const prt::AttributeMap* attrMap) {
 	size_t keyCount = 0;
 	wchar_t const* const* keys = attrMap->getKeys(&keyCount);
 	for (size_t k = 0; k < keyCount; k++) {
@@ -309,14 +369,14 @@ void ToHoudini::extractAttributeNames(const prt::AttributeMap* attrMap) {
 		ph.type = attrMap->getType(key);
 		ph.key.assign(key);
 		ph.cardinality = getAttributeCardinality(attrMap, ph.key, ph.type);
-		addProtoHandle(mHandleMap, key, std::move(ph));
+		addProtoHandle(handleMap, key, std::move(ph));
 	}
 }
 
-void ToHoudini::createAttributeHandles(bool useArrayTypes) {
+void ToHoudini::createAttributeHandles(HandleMap& handleMap, bool useArrayTypes) {
 	WA("all");
 
-	for (auto& hm : mHandleMap) {
+	for (auto& hm : handleMap) {
 		const auto& utKey = hm.first;
 		const auto& type = hm.second.type;
 
@@ -400,13 +460,13 @@ void ToHoudini::createAttributeHandles(bool useArrayTypes) {
 	}
 }
 
-void ToHoudini::setAttributeValues(const prt::AttributeMap* attrMap, const GA_IndexMap& primIndexMap,
-                                   const GA_Offset rangeStart, const GA_Size rangeSize) {
-	for (auto& h : mHandleMap) {
-		if (attrMap->hasKey(h.second.key.c_str())) {
-			const HandleVisitor hv(h.second, attrMap, primIndexMap, rangeStart, rangeSize);
-			std::visit(hv, h.second.handleType);
-		}
+void ToHoudini::setAttributeValues(HandleMap& handleMap, const prt::AttributeMap* attrMap,
+                                   const GA_IndexMap& primIndexMap, const GA_Offset rangeStart,
+                                   const GA_Size rangeSize) {
+	// the schema holds exactly the keys of attrMap
+	for (auto& h : handleMap) {
+		const HandleVisitor hv(h.second, attrMap, primIndexMap, rangeStart, rangeSize, mStrings);
+		std::visit(hv, h.second.handleType);
 	}
 }
 
@@ -423,7 +483,7 @@ void ToHoudini::HandleVisitor::operator()(GA_RWBatchHandleS& handle) const {
 	if (protoHandle.type == prt::Attributable::PT_STRING) {
 		wchar_t const* const v = attrMap->getString(protoHandle.key.c_str());
 		if (v && std::wcslen(v) > 0) {
-			setHandleRange(primIndexMap, handle, rangeStart, rangeSize, 0, std::wstring(v));
+			setHandleRange(primIndexMap, handle, rangeStart, rangeSize, 0, strings.get(v));
 		}
 	}
 	else if (protoHandle.type == prt::Attributable::PT_STRING_ARRAY) {
@@ -431,7 +491,7 @@ void ToHoudini::HandleVisitor::operator()(GA_RWBatchHandleS& handle) const {
 		wchar_t const* const* const v = attrMap->getStringArray(protoHandle.key.c_str(), &arraySize);
 		for (size_t i = 0; i < arraySize; i++) {
 			if (v && v[i] && std::wcslen(v[i]) > 0) {
-				setHandleRange(primIndexMap, handle, rangeStart, rangeSize, i, std::wstring(v[i]));
+				setHandleRange(primIndexMap, handle, rangeStart, rangeSize, i, strings.get(v[i]));
 			}
 		}
 	}
@@ -493,7 +553,76 @@ void ToHoudini::HandleVisitor::operator()(GA_RWHandleIA& handle) const {
 void ToHoudini::HandleVisitor::operator()(GA_RWHandleSA& handle) const {
 	size_t arraySize = 0;
 	wchar_t const* const* const array = attrMap->getStringArray(protoHandle.key.c_str(), &arraySize);
-	setHandleRange(primIndexMap, handle, rangeStart, rangeSize, array, arraySize);
+	UT_StringArray hv(arraySize, arraySize);
+	for (size_t i = 0; i < arraySize; i++)
+		hv[i] = strings.get(array[i]);
+	setHandleRange(primIndexMap, handle, rangeStart, rangeSize, hv);
+}
+
+UT_OptionsHolder toOptions(const prt::AttributeMap* attrMap) {
+	UT_Options options;
+	size_t keyCount = 0;
+	wchar_t const* const* keys = attrMap->getKeys(&keyCount);
+	for (size_t k = 0; k < keyCount; k++) {
+		wchar_t const* key = keys[k];
+		const UT_StringHolder name(NameConversion::toPrimAttr(key));
+		switch (attrMap->getType(key)) {
+			case prt::Attributable::PT_BOOL:
+				options.setOptionB(name, attrMap->getBool(key));
+				break;
+			case prt::Attributable::PT_INT:
+				options.setOptionI(name, attrMap->getInt(key));
+				break;
+			case prt::Attributable::PT_FLOAT:
+				options.setOptionF(name, attrMap->getFloat(key));
+				break;
+			case prt::Attributable::PT_STRING: {
+				wchar_t const* const v = attrMap->getString(key);
+				options.setOptionS(name, UT_StringHolder(toOSNarrowFromUTF16(v ? v : L"")));
+				break;
+			}
+			case prt::Attributable::PT_BOOL_ARRAY: {
+				size_t arraySize = 0;
+				const bool* const v = attrMap->getBoolArray(key, &arraySize);
+				UT_Int64Array ov(arraySize, arraySize);
+				for (size_t i = 0; i < arraySize; i++)
+					ov[i] = v[i] ? 1 : 0;
+				options.setOptionIArray(name, ov);
+				break;
+			}
+			case prt::Attributable::PT_INT_ARRAY: {
+				size_t arraySize = 0;
+				const int32_t* const v = attrMap->getIntArray(key, &arraySize);
+				UT_Int64Array ov(arraySize, arraySize);
+				for (size_t i = 0; i < arraySize; i++)
+					ov[i] = v[i];
+				options.setOptionIArray(name, ov);
+				break;
+			}
+			case prt::Attributable::PT_FLOAT_ARRAY: {
+				size_t arraySize = 0;
+				const double* const v = attrMap->getFloatArray(key, &arraySize);
+				UT_Fpreal64Array ov;
+				ov.append(v, arraySize);
+				options.setOptionFArray(name, ov);
+				break;
+			}
+			case prt::Attributable::PT_STRING_ARRAY: {
+				size_t arraySize = 0;
+				wchar_t const* const* const v = attrMap->getStringArray(key, &arraySize);
+				UT_StringArray ov(arraySize, arraySize);
+				for (size_t i = 0; i < arraySize; i++)
+					ov[i] = UT_StringHolder(toOSNarrowFromUTF16(v[i] ? v[i] : L""));
+				options.setOptionSArray(name, ov);
+				break;
+			}
+			default:
+				if (DBG)
+					LOG_DBG << "ignored: " << key;
+				break;
+		}
+	}
+	return UT_OptionsHolder(&options);
 }
 
 } // namespace AttributeConversion
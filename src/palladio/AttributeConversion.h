@@ -22,8 +22,11 @@
 #include "prt/AttributeMap.h"
 
 #include "GU/GU_Detail.h"
+#include "UT/UT_Options.h"
 
+#include <deque>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 
@@ -65,6 +68,20 @@ private:
 	prt::AttributeMapBuilder& mBuilder;
 };
 
+/**
+ * interns the string values of the attribute maps: each distinct string is converted only once, the shared holder
+ * (with its cached hash) is then reused for all ranges. Not synchronized, owned by one ToHoudini and therefore only
+ * accessed while its detail is locked.
+ */
+class StringTable {
+public:
+	const UT_StringHolder& get(const wchar_t* s);
+
+private:
+	std::deque<std::wstring> mKeys; // stable storage for the views in mStrings
+	std::unordered_map<std::wstring_view, UT_StringHolder> mStrings;
+};
+
 class ToHoudini {
 public:
 	ToHoudini(GU_Detail* detail) : mDetail(detail) {}
@@ -93,8 +110,8 @@ private:
 	class HandleVisitor {
 	public:
 		HandleVisitor(const ProtoHandle& ph, const prt::AttributeMap* m, const GA_IndexMap& pim, GA_Offset rStart,
-		              GA_Size rSize)
-		    : protoHandle(ph), attrMap(m), primIndexMap(pim), rangeStart(rStart), rangeSize(rSize) {}
+		              GA_Size rSize, StringTable& st)
+		    : protoHandle(ph), attrMap(m), primIndexMap(pim), rangeStart(rStart), rangeSize(rSize), strings(st) {}
 		void operator()(const NoHandle& handle) const {}
 		void operator()(GA_RWBatchHandleS& handle) const;
 		void operator()(GA_RWHandleI& handle) const;
@@ -110,21 +127,34 @@ private:
 		const GA_IndexMap& primIndexMap;
 		GA_Offset rangeStart;
 		GA_Size rangeSize;
+		StringTable& strings;
 	};
 
 	using HandleMap = std::unordered_map<UT_StringHolder, ProtoHandle>;
 
-	void extractAttributeNames(const prt::AttributeMap* attrMap);
-	void createAttributeHandles(bool useArrayTypes);
-	void setAttributeValues(const prt::AttributeMap* attrMap, const GA_IndexMap& primIndexMap,
+	// attribute maps with the same keys, types and cardinalities (e.g. the materials or reports of one rule package)
+	// share a schema, i.e. their primitive attributes are created and bound only once per detail
+	HandleMap& getSchema(const prt::AttributeMap* attrMap, bool useArrayTypes);
+	bool isBound(const HandleMap& handleMap) const;
+
+	void extractAttributeNames(HandleMap& handleMap, const prt::AttributeMap* attrMap);
+	void createAttributeHandles(HandleMap& handleMap, bool useArrayTypes);
+	void setAttributeValues(HandleMap& handleMap, const prt::AttributeMap* attrMap, const GA_IndexMap& primIndexMap,
 	                        const GA_Offset rangeStart, const GA_Size rangeSize);
 	void addProtoHandle(HandleMap& handleMap, const std::wstring& handleName, ProtoHandle&& ph);
 
 private:
 	GU_Detail* mDetail;
-	HandleMap mHandleMap;
+	std::unordered_map<uint64_t, HandleMap> mSchemas; // by schema key
+	StringTable mStrings;
 };
 
+/**
+ * converts the attribute map into a dictionary, e.g. for detail attributes (keys are converted like primitive
+ * attribute names, bool values become ints)
+ */
+UT_OptionsHolder toOptions(const prt::AttributeMap* attrMap);
+
 } // namespace AttributeConversion
 
 namespace NameConversion {
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+
+/**
+ * set once by the cooking thread when Houdini reports an interrupt, polled by the generate threads and PRT callbacks.
+ * UT_AutoInterrupt must only be queried from the cooking thread, this token can be read from any thread.
+ */
+class CancellationToken final {
+public:
+	void cancel() {
+		mCancelled.store(true, std::memory_order_relaxed);
+	}
+
+	bool isCancelled() const {
+		return mCancelled.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<bool> mCancelled{false};
+};
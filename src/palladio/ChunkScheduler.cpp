@@ -0,0 +1,156 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ChunkScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace {
+
+constexpr size_t CHUNKS_PER_WORKER = 8; // enough slack to balance expensive shapes without too much call overhead
+
+// the valid group ends, always including the end of the last group
+std::vector<size_t> getGroupEnds(const std::vector<size_t>& groupEnds, size_t numItems) {
+	std::vector<size_t> ends;
+	for (const size_t e : groupEnds) {
+		if (e > 0 && e < numItems && (ends.empty() || e > ends.back()))
+			ends.push_back(e);
+	}
+	ends.push_back(numItems);
+	return ends;
+}
+
+} // namespace
+
+ChunkScheduler::ChunkScheduler(size_t numItems, size_t chunkSize, size_t numWorkers,
+                               const std::vector<size_t>& groupEnds)
+    : mQueues(std::max<size_t>(numWorkers, 1)) {
+	if (chunkSize == 0)
+		chunkSize = getDefaultChunkSize(numItems, mQueues.size());
+
+	std::vector<Chunk> chunks;
+	std::vector<double> chunkCosts;
+	size_t groupBegin = 0;
+	for (const size_t groupEnd : getGroupEnds(groupEnds, numItems)) {
+		for (size_t begin = groupBegin; begin < groupEnd; begin += chunkSize) {
+			chunks.push_back({begin, std::min(begin + chunkSize, groupEnd)});
+			chunkCosts.push_back(static_cast<double>(chunks.back().size()));
+		}
+		groupBegin = groupEnd;
+	}
+	distribute(chunks, chunkCosts);
+}
+
+ChunkScheduler::ChunkScheduler(const std::vector<double>& itemCosts, size_t chunkSize, size_t numWorkers,
+                               const std::vector<size_t>& groupEnds)
+    : mQueues(std::max<size_t>(numWorkers, 1)) {
+	const size_t numItems = itemCosts.size();
+	if (chunkSize == 0)
+		chunkSize = getDefaultChunkSize(numItems, mQueues.size());
+
+	// fall back to item counts if there are no usable costs
+	const double totalCost = std::accumulate(itemCosts.begin(), itemCosts.end(), 0.0);
+	const bool hasCosts = (totalCost > 0.0);
+	const double targetChunkCost = hasCosts ? totalCost / numItems * chunkSize : static_cast<double>(chunkSize);
+
+	// close a chunk as soon as it reaches the target cost, i.e. an expensive item ends up in a chunk of its own,
+	// or at the end of its group
+	const std::vector<size_t> ends = getGroupEnds(groupEnds, numItems);
+	auto nextEnd = ends.begin();
+	std::vector<Chunk> chunks;
+	std::vector<double> chunkCosts;
+	size_t begin = 0;
+	double cost = 0.0;
+	for (size_t i = 0; i < numItems; i++) {
+		cost += hasCosts ? itemCosts[i] : 1.0;
+		const bool isGroupEnd = (i + 1 == *nextEnd);
+		if (isGroupEnd)
+			++nextEnd;
+		if (cost >= targetChunkCost || isGroupEnd) {
+			chunks.push_back({begin, i + 1});
+			chunkCosts.push_back(cost);
+			begin = i + 1;
+			cost = 0.0;
+		}
+	}
+	distribute(chunks, chunkCosts);
+}
+
+void ChunkScheduler::distribute(const std::vector<Chunk>& chunks, const std::vector<double>& chunkCosts) {
+	assert(chunks.size() == chunkCosts.size());
+	mNumChunks = chunks.size();
+
+	// distribute the chunks in contiguous blocks of equal cost over the workers, this keeps neighbouring shapes on the
+	// same worker as long as no stealing happens
+	const double totalCost = std::accumulate(chunkCosts.begin(), chunkCosts.end(), 0.0);
+	const double costPerWorker = totalCost / mQueues.size();
+	double accumulatedCost = 0.0;
+	for (size_t ci = 0; ci < chunks.size(); ci++) {
+		const double midCost = accumulatedCost + chunkCosts[ci] / 2.0;
+		const auto wi = (costPerWorker > 0.0) ? static_cast<size_t>(midCost / costPerWorker) : 0;
+		mQueues[std::min(wi, mQueues.size() - 1)].chunks.push_back(chunks[ci]);
+		accumulatedCost += chunkCosts[ci];
+	}
+}
+
+std::optional<ChunkScheduler::Chunk> ChunkScheduler::next(size_t worker) {
+	assert(worker < mQueues.size());
+
+	// own queue first, from the front
+	{
+		WorkerQueue& own = mQueues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.chunks.empty()) {
+			const Chunk c = own.chunks.front();
+			own.chunks.pop_front();
+			return c;
+		}
+	}
+
+	// steal from the back of the other queues, starting with the neighbour to spread contention
+	for (size_t i = 1; i < mQueues.size(); i++) {
+		WorkerQueue& victim = mQueues[(worker + i) % mQueues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.chunks.empty()) {
+			const Chunk c = victim.chunks.back();
+			victim.chunks.pop_back();
+			mNumSteals++;
+			return c;
+		}
+	}
+
+	return {};
+}
+
+size_t ChunkScheduler::run(size_t worker, const CancellationToken& cancellation,
+                           const std::function<void(const Chunk&)>& processChunk) {
+	size_t numChunks = 0;
+	while (!cancellation.isCancelled()) {
+		const std::optional<Chunk> chunk = next(worker);
+		if (!chunk)
+			break;
+		processChunk(*chunk);
+		numChunks++;
+	}
+	return numChunks;
+}
+
+size_t ChunkScheduler::getDefaultChunkSize(size_t numItems, size_t numWorkers) {
+	const size_t targetChunks = std::max<size_t>(numWorkers, 1) * CHUNKS_PER_WORKER;
+	return std::max<size_t>((numItems + targetChunks - 1) / targetChunks, 1);
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "CancellationToken.h"
+#include "PalladioMain.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+/**
+ * hands out chunks of initial shape indices to a fixed number of workers:
+ * each worker starts with a contiguous share of the chunks and steals from the back of the other queues once its own
+ * queue is drained, i.e. all workers stay busy until the last chunk is taken.
+ * optionally, the items are split into groups (e.g. the initial shapes of one rule package) and no chunk spans two
+ * groups, groupEnds holds the ascending past-the-end index of each group.
+ */
+class PLD_TEST_EXPORTS_API ChunkScheduler {
+public:
+	struct Chunk {
+		size_t begin; // first index of the chunk
+		size_t end;   // past-the-end index of the chunk
+
+		size_t size() const {
+			return end - begin;
+		}
+	};
+
+	ChunkScheduler(size_t numItems, size_t chunkSize, size_t numWorkers, const std::vector<size_t>& groupEnds = {});
+
+	/**
+	 * cost-balanced variant: chunks hold items of roughly equal accumulated cost (chunkSize times the mean item cost)
+	 * and each worker initially receives roughly the same share of the total cost
+	 */
+	ChunkScheduler(const std::vector<double>& itemCosts, size_t chunkSize, size_t numWorkers,
+	               const std::vector<size_t>& groupEnds = {});
+	ChunkScheduler(const ChunkScheduler&) = delete;
+	ChunkScheduler(ChunkScheduler&&) = delete;
+	ChunkScheduler& operator=(const ChunkScheduler&) = delete;
+	ChunkScheduler& operator=(ChunkScheduler&&) = delete;
+	~ChunkScheduler() = default;
+
+	/**
+	 * returns the next chunk for the given worker, or nothing if all chunks have been handed out
+	 */
+	std::optional<Chunk> next(size_t worker);
+
+	/**
+	 * passes the chunks of the given worker to processChunk until all chunks have been handed out or the token is
+	 * cancelled (checked before each chunk), returns the number of processed chunks
+	 */
+	size_t run(size_t worker, const CancellationToken& cancellation,
+	           const std::function<void(const Chunk&)>& processChunk);
+
+	size_t getNumChunks() const {
+		return mNumChunks;
+	}
+	size_t getNumSteals() const {
+		return mNumSteals.load();
+	}
+
+	/**
+	 * picks a chunk size which results in several chunks per worker, so that cheap and expensive
+	 * initial shapes can be balanced by stealing
+	 */
+	static size_t getDefaultChunkSize(size_t numItems, size_t numWorkers);
+
+private:
+	void distribute(const std::vector<Chunk>& chunks, const std::vector<double>& chunkCosts);
+
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<Chunk> chunks;
+	};
+
+	std::vector<WorkerQueue> mQueues;
+	size_t mNumChunks = 0;
+	std::atomic<size_t> mNumSteals = 0;
+};
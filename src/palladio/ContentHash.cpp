@@ -0,0 +1,105 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ContentHash.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+} // namespace
+
+ContentHash& ContentHash::add(const void* data, size_t size) {
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++) {
+		mHash ^= bytes[i];
+		mHash *= FNV_PRIME;
+	}
+	return *this;
+}
+
+ContentHash& ContentHash::add(const std::wstring& s) {
+	add(s.size());
+	return add(s.data(), s.size() * sizeof(wchar_t));
+}
+
+ContentHash& ContentHash::add(const prt::AttributeMap* attributeMap) {
+	if (attributeMap == nullptr)
+		return add(size_t(0));
+
+	size_t keyCount = 0;
+	const wchar_t* const* keys = attributeMap->getKeys(&keyCount);
+	std::vector<std::wstring> sortedKeys(keys, keys + keyCount);
+	std::sort(sortedKeys.begin(), sortedKeys.end());
+
+	add(keyCount);
+	for (const std::wstring& key : sortedKeys) {
+		const wchar_t* k = key.c_str();
+		const prt::Attributable::PrimitiveType type = attributeMap->getType(k);
+		add(key);
+		add(static_cast<int32_t>(type));
+		switch (type) {
+			case prt::Attributable::PT_BOOL:
+				add(attributeMap->getBool(k));
+				break;
+			case prt::Attributable::PT_FLOAT:
+				add(attributeMap->getFloat(k));
+				break;
+			case prt::Attributable::PT_INT:
+				add(attributeMap->getInt(k));
+				break;
+			case prt::Attributable::PT_STRING: {
+				const wchar_t* v = attributeMap->getString(k);
+				add(std::wstring(v != nullptr ? v : L""));
+				break;
+			}
+			case prt::Attributable::PT_BOOL_ARRAY: {
+				size_t n = 0;
+				const bool* v = attributeMap->getBoolArray(k, &n);
+				add(n);
+				add(v, n * sizeof(bool));
+				break;
+			}
+			case prt::Attributable::PT_FLOAT_ARRAY: {
+				size_t n = 0;
+				const double* v = attributeMap->getFloatArray(k, &n);
+				add(n);
+				add(v, n * sizeof(double));
+				break;
+			}
+			case prt::Attributable::PT_INT_ARRAY: {
+				size_t n = 0;
+				const int32_t* v = attributeMap->getIntArray(k, &n);
+				add(n);
+				add(v, n * sizeof(int32_t));
+				break;
+			}
+			case prt::Attributable::PT_STRING_ARRAY: {
+				size_t n = 0;
+				const wchar_t* const* v = attributeMap->getStringArray(k, &n);
+				add(n);
+				for (size_t i = 0; i < n; i++)
+					add(std::wstring(v[i] != nullptr ? v[i] : L""));
+				break;
+			}
+			default:
+				break;
+		}
+	}
+	return *this;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "PalladioMain.h"
+
+#include "prt/AttributeMap.h"
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * 64bit FNV-1a hash over the content of initial shapes and their settings:
+ * in contrast to std::hash the result is stable across processes, but not across platforms: the values are hashed as
+ * raw bytes, i.e. the result depends on the byte order and on the size of wchar_t (2 bytes on Windows, 4 on Linux)
+ */
+class PLD_TEST_EXPORTS_API ContentHash {
+public:
+	ContentHash& add(const void* data, size_t size);
+
+	template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+	ContentHash& add(T value) {
+		return add(&value, sizeof(T));
+	}
+
+	template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+	ContentHash& add(const std::vector<T>& values) {
+		add(values.size());
+		return add(values.data(), values.size() * sizeof(T));
+	}
+
+	ContentHash& add(const std::wstring& s);
+
+	/**
+	 * hashes keys, types and values of the attribute map, independent of the order of the keys
+	 */
+	ContentHash& add(const prt::AttributeMap* attributeMap);
+
+	uint64_t get() const {
+		return mHash;
+	}
+
+private:
+	uint64_t mHash = 14695981039346656037ull; // FNV offset basis
+};
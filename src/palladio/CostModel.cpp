@@ -0,0 +1,72 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CostModel.h"
+
+namespace {
+
+constexpr double UNITS_PER_SHAPE = 16.0; // fixed overhead per initial shape, independent of its geometry
+constexpr double DEFAULT_SECONDS_PER_UNIT = 1.0;
+constexpr double SMOOTHING = 0.5; // weight of a new measurement, older cooks fade out quickly
+
+} // namespace
+
+double CostModel::getUnits(size_t numFaces, size_t numVertices) {
+	return UNITS_PER_SHAPE + static_cast<double>(numFaces) + static_cast<double>(numVertices);
+}
+
+double CostModel::getSecondsPerUnit(const std::filesystem::path& rpk, const std::wstring& startRule) const {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const auto rpkIt = mSecondsPerUnit.find(rpk);
+	if (rpkIt != mSecondsPerUnit.end()) {
+		const auto ruleIt = rpkIt->second.find(startRule);
+		if (ruleIt != rpkIt->second.end())
+			return ruleIt->second;
+	}
+
+	double sum = 0.0;
+	size_t count = 0;
+	for (const auto& rpkCosts : mSecondsPerUnit) {
+		for (const auto& ruleCost : rpkCosts.second) {
+			sum += ruleCost.second;
+			count++;
+		}
+	}
+	return (count > 0) ? sum / count : DEFAULT_SECONDS_PER_UNIT;
+}
+
+void CostModel::addMeasurement(const std::filesystem::path& rpk, const std::wstring& startRule, double units,
+                               double seconds) {
+	if (units <= 0.0 || seconds < 0.0)
+		return;
+
+	const double secondsPerUnit = seconds / units;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	StartRuleCosts& ruleCosts = mSecondsPerUnit[rpk];
+	const auto it = ruleCosts.find(startRule);
+	if (it == ruleCosts.end())
+		ruleCosts.emplace(startRule, secondsPerUnit);
+	else
+		it->second = SMOOTHING * secondsPerUnit + (1.0 - SMOOTHING) * it->second;
+}
+
+bool CostModel::hasMeasurement(const std::filesystem::path& rpk, const std::wstring& startRule) const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	const auto rpkIt = mSecondsPerUnit.find(rpk);
+	return (rpkIt != mSecondsPerUnit.end()) && (rpkIt->second.count(startRule) > 0);
+}
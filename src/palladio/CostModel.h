@@ -0,0 +1,60 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "PalladioMain.h"
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * estimates the generate cost of initial shapes:
+ * the input geometry size (in "units") is weighted with the time per unit measured for the same rule package and
+ * start rule in earlier cooks. The measurements persist for the lifetime of the PRT context.
+ */
+class PLD_TEST_EXPORTS_API CostModel final {
+public:
+	CostModel() = default;
+	CostModel(const CostModel&) = delete;
+	CostModel(CostModel&&) = delete;
+	CostModel& operator=(const CostModel&) = delete;
+	CostModel& operator=(CostModel&&) = delete;
+	~CostModel() = default;
+
+	static double getUnits(size_t numFaces, size_t numVertices);
+
+	/**
+	 * returns the measured seconds per unit, or the mean of all measurements if the start rule has not been measured
+	 * yet, or 1.0 if there are no measurements at all (i.e. the cost is proportional to the geometry size)
+	 */
+	double getSecondsPerUnit(const std::filesystem::path& rpk, const std::wstring& startRule) const;
+
+	void addMeasurement(const std::filesystem::path& rpk, const std::wstring& startRule, double units,
+	                    double seconds);
+
+	bool hasMeasurement(const std::filesystem::path& rpk, const std::wstring& startRule) const;
+
+private:
+	using StartRuleCosts = std::map<std::wstring, double>;
+	std::map<std::filesystem::path, StartRuleCosts> mSecondsPerUnit; // per rpk
+	mutable std::mutex mMutex;
+};
+
+using CostModelUPtr = std::unique_ptr<CostModel>;
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GeneratedModelCache.h"
+
+#include "prt/AttributeMap.h"
+
+namespace {
+
+constexpr size_t ATTRIBUTE_MAP_OVERHEAD = 256; // rough guess, prt does not expose the size of an attribute map
+constexpr size_t ATTRIBUTE_SIZE = 64;
+
+template <typename T>
+size_t getSize(const std::vector<T>& v) {
+	return v.size() * sizeof(T);
+}
+
+template <typename T>
+size_t getSize(const std::vector<std::vector<T>>& vv) {
+	size_t s = 0;
+	for (const auto& v : vv)
+		s += sizeof(std::vector<T>) + getSize(v);
+	return s;
+}
+
+size_t getSize(const AttributeMapVector& maps) {
+	size_t s = 0;
+	for (const auto& m : maps) {
+		if (!m)
+			continue;
+		size_t keyCount = 0;
+		m->getKeys(&keyCount);
+		s += ATTRIBUTE_MAP_OVERHEAD + keyCount * ATTRIBUTE_SIZE;
+	}
+	return s;
+}
+
+} // namespace
+
+size_t GeneratedMesh::getSize() const {
+	return sizeof(GeneratedMesh) + ::getSize(vtx) + ::getSize(nrm) + ::getSize(counts) + ::getSize(holeCounts) +
+	       ::getSize(holeIndices) + ::getSize(vertexIndices) + ::getSize(normalIndices) + ::getSize(uvs) +
+	       ::getSize(uvCounts) + ::getSize(uvIndices) + ::getSize(faceRanges) + ::getSize(materials) +
+	       ::getSize(reports) + ::getSize(shapeAttributes) + ::getSize(shapeIDs);
+}
+
+size_t GeneratedModel::getSize() const {
+	size_t s = sizeof(GeneratedModel);
+	for (const GeneratedMeshSPtr& m : meshes)
+		s += m->getSize();
+	return s;
+}
+
+GeneratedModelSPtr GeneratedModelCache::get(uint64_t key) {
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const auto it = mIndex.find(key);
+	if (it == mIndex.end()) {
+		mStats.misses++;
+		return {};
+	}
+
+	mEntries.splice(mEntries.begin(), mEntries, it->second); // mark as most recently used
+	mStats.hits++;
+	return it->second->model;
+}
+
+void GeneratedModelCache::insert(uint64_t key, GeneratedModelSPtr model) {
+	if (!model)
+		return;
+
+	const size_t size = model->getSize();
+	if (size > mBudget)
+		return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	const auto it = mIndex.find(key);
+	if (it != mIndex.end()) { // replace, e.g. after a concurrent generate of the same initial shape
+		mStats.bytes -= it->second->size;
+		mEntries.erase(it->second);
+		mIndex.erase(it);
+	}
+
+	evict(size);
+	mEntries.push_front({key, std::move(model), size});
+	mIndex.emplace(key, mEntries.begin());
+	mStats.bytes += size;
+	mStats.insertions++;
+}
+
+void GeneratedModelCache::evict(size_t requiredBytes) {
+	while (!mEntries.empty() && mStats.bytes + requiredBytes > mBudget) {
+		const Entry& lru = mEntries.back();
+		mStats.bytes -= lru.size;
+		mIndex.erase(lru.key);
+		mEntries.pop_back();
+		mStats.evictions++;
+	}
+}
+
+void GeneratedModelCache::clear() {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mEntries.clear();
+	mIndex.clear();
+	mStats.bytes = 0;
+}
+
+GeneratedModelCache::Stats GeneratedModelCache::getStats() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	Stats stats = mStats;
+	stats.entries = mEntries.size();
+	stats.budget = mBudget;
+	return stats;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "PalladioMain.h"
+#include "Utils.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * copy of the arguments of one HoudiniCallbacks::add call (except the initial shape index and name)
+ */
+struct GeneratedMesh {
+	std::vector<double> vtx;
+	std::vector<double> nrm;
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> holeCounts;
+	std::vector<uint32_t> holeIndices;
+	std::vector<uint32_t> vertexIndices;
+	std::vector<uint32_t> normalIndices;
+
+	std::vector<std::vector<double>> uvs; // per uv set
+	std::vector<std::vector<uint32_t>> uvCounts;
+	std::vector<std::vector<uint32_t>> uvIndices;
+
+	std::vector<uint32_t> faceRanges;
+	AttributeMapVector materials;       // per face range, empty if materials are not emitted
+	AttributeMapVector reports;         // per face range, empty if reports are not emitted
+	AttributeMapVector shapeAttributes; // per face range, entries are null for shapes without attributes
+	std::vector<int32_t> shapeIDs;
+
+	size_t getSize() const;
+};
+
+using GeneratedMeshSPtr = std::shared_ptr<const GeneratedMesh>;
+
+/**
+ * the geometry generated for one initial shape (might be empty)
+ */
+struct GeneratedModel {
+	std::vector<GeneratedMeshSPtr> meshes; // immutable, i.e. can be shared, e.g. with the deferred meshes
+
+	size_t getSize() const;
+};
+
+using GeneratedModelSPtr = std::shared_ptr<const GeneratedModel>;
+
+/**
+ * keeps the generated models of initial shapes, keyed by the content hash of the initial shape and the encoder
+ * options, and evicts the least recently used models once the memory budget (in bytes) is exceeded
+ */
+class PLD_TEST_EXPORTS_API GeneratedModelCache final {
+public:
+	struct Stats {
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t insertions = 0;
+		size_t evictions = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+		size_t budget = 0;
+	};
+
+	explicit GeneratedModelCache(size_t budget) : mBudget(budget) {}
+	GeneratedModelCache(const GeneratedModelCache&) = delete;
+	GeneratedModelCache(GeneratedModelCache&&) = delete;
+	GeneratedModelCache& operator=(const GeneratedModelCache&) = delete;
+	GeneratedModelCache& operator=(GeneratedModelCache&&) = delete;
+	~GeneratedModelCache() = default;
+
+	GeneratedModelSPtr get(uint64_t key);
+
+	// models which do not fit into the budget on their own are not stored
+	void insert(uint64_t key, GeneratedModelSPtr model);
+
+	void clear();
+	Stats getStats() const;
+
+private:
+	struct Entry {
+		uint64_t key;
+		GeneratedModelSPtr model;
+		size_t size;
+	};
+	using EntryList = std::list<Entry>; // most recently used first
+
+	void evict(size_t requiredBytes);
+
+	EntryList mEntries;
+	std::unordered_map<uint64_t, EntryList::iterator> mIndex;
+	const size_t mBudget;
+	Stats mStats;
+	mutable std::mutex mMutex;
+};
+
+using GeneratedModelCacheUPtr = std::unique_ptr<GeneratedModelCache>;
@@ -0,0 +1,484 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GeneratedModelDiskCache.h"
+
+#include "prt/AttributeMap.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+
+#ifdef PLD_LINUX
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#elif defined(PLD_WINDOWS)
+#	include <process.h>
+#endif
+
+namespace {
+
+constexpr char MAGIC[4] = {'P', 'L', 'D', 'M'};
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr const char* FILE_EXTENSION = ".pldm";
+
+// -- serialization
+
+class Writer {
+public:
+	std::vector<uint8_t> mBuffer;
+
+	void write(const void* data, size_t size) {
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+	}
+
+	template <typename T>
+	void write(T value) {
+		write(&value, sizeof(T));
+	}
+
+	template <typename T>
+	void write(const std::vector<T>& values) {
+		write(static_cast<uint64_t>(values.size()));
+		write(values.data(), values.size() * sizeof(T));
+	}
+
+	void write(const std::wstring& s) {
+		write(static_cast<uint64_t>(s.size()));
+		write(s.data(), s.size() * sizeof(wchar_t));
+	}
+
+	void write(const prt::AttributeMap* attributeMap);
+
+	void write(const AttributeMapVector& maps) {
+		write(static_cast<uint64_t>(maps.size()));
+		for (const auto& m : maps)
+			write(m.get());
+	}
+};
+
+void Writer::write(const prt::AttributeMap* attributeMap) {
+	write(static_cast<uint8_t>(attributeMap != nullptr));
+	if (attributeMap == nullptr)
+		return;
+
+	size_t keyCount = 0;
+	const wchar_t* const* keys = attributeMap->getKeys(&keyCount);
+	write(static_cast<uint64_t>(keyCount));
+	for (size_t k = 0; k < keyCount; k++) {
+		const wchar_t* key = keys[k];
+		const prt::Attributable::PrimitiveType type = attributeMap->getType(key);
+		write(std::wstring(key));
+		write(static_cast<int32_t>(type));
+		switch (type) {
+			case prt::Attributable::PT_BOOL:
+				write(static_cast<uint8_t>(attributeMap->getBool(key)));
+				break;
+			case prt::Attributable::PT_FLOAT:
+				write(attributeMap->getFloat(key));
+				break;
+			case prt::Attributable::PT_INT:
+				write(attributeMap->getInt(key));
+				break;
+			case prt::Attributable::PT_STRING: {
+				const wchar_t* v = attributeMap->getString(key);
+				write(std::wstring(v != nullptr ? v : L""));
+				break;
+			}
+			case prt::Attributable::PT_BOOL_ARRAY: {
+				size_t n = 0;
+				const bool* v = attributeMap->getBoolArray(key, &n);
+				write(static_cast<uint64_t>(n));
+				for (size_t i = 0; i < n; i++)
+					write(static_cast<uint8_t>(v[i]));
+				break;
+			}
+			case prt::Attributable::PT_FLOAT_ARRAY: {
+				size_t n = 0;
+				const double* v = attributeMap->getFloatArray(key, &n);
+				write(std::vector<double>(v, v + n));
+				break;
+			}
+			case prt::Attributable::PT_INT_ARRAY: {
+				size_t n = 0;
+				const int32_t* v = attributeMap->getIntArray(key, &n);
+				write(std::vector<int32_t>(v, v + n));
+				break;
+			}
+			case prt::Attributable::PT_STRING_ARRAY: {
+				size_t n = 0;
+				const wchar_t* const* v = attributeMap->getStringArray(key, &n);
+				write(static_cast<uint64_t>(n));
+				for (size_t i = 0; i < n; i++)
+					write(std::wstring(v[i] != nullptr ? v[i] : L""));
+				break;
+			}
+			default:
+				break;
+		}
+	}
+}
+
+// reads from a memory block, any read past the end marks the reader as failed
+class Reader {
+public:
+	Reader(const uint8_t* data, size_t size) : mPos(data), mEnd(data + size) {}
+
+	bool ok() const {
+		return mOK;
+	}
+
+	bool read(void* data, size_t size) {
+		if (!mOK || static_cast<size_t>(mEnd - mPos) < size) {
+			mOK = false;
+			return false;
+		}
+		std::memcpy(data, mPos, size);
+		mPos += size;
+		return true;
+	}
+
+	template <typename T>
+	T read() {
+		T value{};
+		read(&value, sizeof(T));
+		return value;
+	}
+
+	template <typename T>
+	void read(std::vector<T>& values) {
+		const size_t n = readCount(sizeof(T));
+		values.resize(n);
+		read(values.data(), n * sizeof(T));
+	}
+
+	std::wstring readString() {
+		const size_t n = readCount(sizeof(wchar_t));
+		std::wstring s(n, L'\0');
+		read(s.data(), n * sizeof(wchar_t));
+		return s;
+	}
+
+	AttributeMapUPtr readAttributeMap();
+
+	void read(AttributeMapVector& maps) {
+		const size_t n = readCount(1);
+		maps.resize(n);
+		for (size_t i = 0; i < n && mOK; i++)
+			maps[i] = readAttributeMap();
+	}
+
+	// guards against allocating huge amounts of memory for corrupt counts
+	size_t readCount(size_t elementSize) {
+		const auto n = read<uint64_t>();
+		if (!mOK || n > static_cast<uint64_t>(mEnd - mPos) / elementSize) {
+			mOK = false;
+			return 0;
+		}
+		return static_cast<size_t>(n);
+	}
+
+private:
+	const uint8_t* mPos;
+	const uint8_t* mEnd;
+	bool mOK = true;
+};
+
+AttributeMapUPtr Reader::readAttributeMap() {
+	if (read<uint8_t>() == 0)
+		return {};
+
+	AttributeMapBuilderUPtr amb(prt::AttributeMapBuilder::create());
+	const size_t keyCount = readCount(1);
+	for (size_t k = 0; k < keyCount && mOK; k++) {
+		const std::wstring key = readString();
+		const auto type = static_cast<prt::Attributable::PrimitiveType>(read<int32_t>());
+		switch (type) {
+			case prt::Attributable::PT_BOOL:
+				amb->setBool(key.c_str(), read<uint8_t>() != 0);
+				break;
+			case prt::Attributable::PT_FLOAT:
+				amb->setFloat(key.c_str(), read<double>());
+				break;
+			case prt::Attributable::PT_INT:
+				amb->setInt(key.c_str(), read<int32_t>());
+				break;
+			case prt::Attributable::PT_STRING:
+				amb->setString(key.c_str(), readString().c_str());
+				break;
+			case prt::Attributable::PT_BOOL_ARRAY: {
+				const size_t n = readCount(1);
+				const std::unique_ptr<bool[]> v(new bool[n]);
+				for (size_t i = 0; i < n; i++)
+					v[i] = (read<uint8_t>() != 0);
+				amb->setBoolArray(key.c_str(), v.get(), n);
+				break;
+			}
+			case prt::Attributable::PT_FLOAT_ARRAY: {
+				std::vector<double> v;
+				read(v);
+				amb->setFloatArray(key.c_str(), v.data(), v.size());
+				break;
+			}
+			case prt::Attributable::PT_INT_ARRAY: {
+				std::vector<int32_t> v;
+				read(v);
+				amb->setIntArray(key.c_str(), v.data(), v.size());
+				break;
+			}
+			case prt::Attributable::PT_STRING_ARRAY: {
+				const size_t n = readCount(sizeof(uint64_t));
+				std::vector<std::wstring> v(n);
+				std::vector<const wchar_t*> vPtrs(n);
+				for (size_t i = 0; i < n; i++) {
+					v[i] = readString();
+					vPtrs[i] = v[i].c_str();
+				}
+				amb->setStringArray(key.c_str(), vPtrs.data(), vPtrs.size());
+				break;
+			}
+			default:
+				break;
+		}
+	}
+	return AttributeMapUPtr(amb->createAttributeMap());
+}
+
+// -- file access
+
+#ifdef PLD_LINUX
+
+// read-only memory mapping of a whole file
+class FileView {
+public:
+	explicit FileView(const std::filesystem::path& path) {
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				mData = static_cast<const uint8_t*>(p);
+				mSize = static_cast<size_t>(st.st_size);
+			}
+		}
+		::close(fd); // the mapping stays valid
+	}
+	FileView(const FileView&) = delete;
+	FileView& operator=(const FileView&) = delete;
+	~FileView() {
+		if (mData != nullptr)
+			::munmap(const_cast<uint8_t*>(mData), mSize);
+	}
+
+	const uint8_t* data() const {
+		return mData;
+	}
+	size_t size() const {
+		return mSize;
+	}
+
+private:
+	const uint8_t* mData = nullptr;
+	size_t mSize = 0;
+};
+
+#else
+
+class FileView {
+public:
+	explicit FileView(const std::filesystem::path& path) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+			return;
+		mBuffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	const uint8_t* data() const {
+		return mBuffer.empty() ? nullptr : reinterpret_cast<const uint8_t*>(mBuffer.data());
+	}
+	size_t size() const {
+		return mBuffer.size();
+	}
+
+private:
+	std::vector<char> mBuffer;
+};
+
+#endif
+
+int getProcessId() {
+#ifdef PLD_WINDOWS
+	return _getpid();
+#else
+	return ::getpid();
+#endif
+}
+
+// unique per process and thread, concurrent writers of the same model must not share a temporary file
+std::string getTemporarySuffix() {
+	static std::atomic<uint64_t> counter{0};
+	const size_t threadHash = std::hash<std::thread::id>{}(std::this_thread::get_id());
+	return ".tmp" + std::to_string(getProcessId()) + "_" + std::to_string(threadHash) + "_" + std::to_string(counter++);
+}
+
+} // namespace
+
+namespace GeneratedModelSerialization {
+
+std::vector<uint8_t> serialize(uint64_t key, const GeneratedModel& model) {
+	Writer w;
+	w.write(MAGIC, sizeof(MAGIC));
+	w.write(FORMAT_VERSION);
+	w.write(static_cast<uint32_t>(sizeof(wchar_t)));
+	w.write(key);
+
+	w.write(static_cast<uint64_t>(model.meshes.size()));
+	for (const GeneratedMeshSPtr& meshPtr : model.meshes) {
+		const GeneratedMesh& mesh = *meshPtr;
+		w.write(mesh.vtx);
+		w.write(mesh.nrm);
+		w.write(mesh.counts);
+		w.write(mesh.holeCounts);
+		w.write(mesh.holeIndices);
+		w.write(mesh.vertexIndices);
+		w.write(mesh.normalIndices);
+
+		w.write(static_cast<uint64_t>(mesh.uvs.size()));
+		for (size_t uvSet = 0; uvSet < mesh.uvs.size(); uvSet++) {
+			w.write(mesh.uvs[uvSet]);
+			w.write(mesh.uvCounts[uvSet]);
+			w.write(mesh.uvIndices[uvSet]);
+		}
+
+		w.write(mesh.faceRanges);
+		w.write(mesh.materials);
+		w.write(mesh.reports);
+		w.write(mesh.shapeAttributes);
+		w.write(mesh.shapeIDs);
+	}
+	return std::move(w.mBuffer);
+}
+
+GeneratedModelSPtr deserialize(uint64_t key, const uint8_t* data, size_t size) {
+	if (data == nullptr)
+		return {};
+
+	Reader r(data, size);
+	char magic[sizeof(MAGIC)];
+	r.read(magic, sizeof(magic));
+	if (!r.ok() || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+		return {};
+	if (r.read<uint32_t>() != FORMAT_VERSION || r.read<uint32_t>() != sizeof(wchar_t) || r.read<uint64_t>() != key)
+		return {};
+
+	auto model = std::make_shared<GeneratedModel>();
+	const size_t numMeshes = r.readCount(1);
+	model->meshes.reserve(numMeshes);
+	for (size_t mi = 0; mi < numMeshes; mi++) {
+		auto meshPtr = std::make_shared<GeneratedMesh>();
+		GeneratedMesh& mesh = *meshPtr;
+		r.read(mesh.vtx);
+		r.read(mesh.nrm);
+		r.read(mesh.counts);
+		r.read(mesh.holeCounts);
+		r.read(mesh.holeIndices);
+		r.read(mesh.vertexIndices);
+		r.read(mesh.normalIndices);
+
+		const size_t uvSets = r.readCount(1);
+		mesh.uvs.resize(uvSets);
+		mesh.uvCounts.resize(uvSets);
+		mesh.uvIndices.resize(uvSets);
+		for (size_t uvSet = 0; uvSet < uvSets; uvSet++) {
+			r.read(mesh.uvs[uvSet]);
+			r.read(mesh.uvCounts[uvSet]);
+			r.read(mesh.uvIndices[uvSet]);
+		}
+
+		r.read(mesh.faceRanges);
+		r.read(mesh.materials);
+		r.read(mesh.reports);
+		r.read(mesh.shapeAttributes);
+		r.read(mesh.shapeIDs);
+
+		if (!r.ok())
+			return {};
+		model->meshes.emplace_back(std::move(meshPtr));
+	}
+	return r.ok() ? model : GeneratedModelSPtr();
+}
+
+} // namespace GeneratedModelSerialization
+
+GeneratedModelSPtr GeneratedModelDiskCache::get(uint64_t key) {
+	const FileView view(getPath(key));
+	GeneratedModelSPtr model = GeneratedModelSerialization::deserialize(key, view.data(), view.size());
+	if (model)
+		mHits++;
+	else
+		mMisses++;
+	return model;
+}
+
+bool GeneratedModelDiskCache::put(uint64_t key, const GeneratedModel& model) {
+	const std::filesystem::path path = getPath(key);
+	std::filesystem::path tmpPath = path;
+	tmpPath += getTemporarySuffix();
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	const std::vector<uint8_t> data = GeneratedModelSerialization::serialize(key, model);
+	bool written = false;
+	{
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		written = out.good();
+	}
+
+	// readers either see the complete old or the complete new file
+	if (written)
+		std::filesystem::rename(tmpPath, path, ec);
+	if (!written || ec) {
+		std::filesystem::remove(tmpPath, ec);
+		mFailedWrites++;
+		return false;
+	}
+
+	mWrites++;
+	return true;
+}
+
+std::filesystem::path GeneratedModelDiskCache::getPath(uint64_t key) const {
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return mDirectory / std::string(name, 2) / (std::string(name) + FILE_EXTENSION);
+}
+
+GeneratedModelDiskCache::Stats GeneratedModelDiskCache::getStats() const {
+	return {mHits.load(), mMisses.load(), mWrites.load(), mFailedWrites.load()};
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "GeneratedModelCache.h"
+#include "PalladioMain.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace GeneratedModelSerialization {
+
+PLD_TEST_EXPORTS_API std::vector<uint8_t> serialize(uint64_t key, const GeneratedModel& model);
+
+// returns null if the data is truncated, has been written by an incompatible version/platform or for another key
+PLD_TEST_EXPORTS_API GeneratedModelSPtr deserialize(uint64_t key, const uint8_t* data, size_t size);
+
+} // namespace GeneratedModelSerialization
+
+/**
+ * persistent generated models, one file per model key in the cache directory. Files are written to a temporary file
+ * first and then renamed, i.e. several processes can share the same directory. The cache never deletes files, the
+ * directory must be cleaned up externally.
+ */
+class PLD_TEST_EXPORTS_API GeneratedModelDiskCache final {
+public:
+	struct Stats {
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t writes = 0;
+		size_t failedWrites = 0;
+	};
+
+	explicit GeneratedModelDiskCache(const std::filesystem::path& directory) : mDirectory(directory) {}
+	GeneratedModelDiskCache(const GeneratedModelDiskCache&) = delete;
+	GeneratedModelDiskCache(GeneratedModelDiskCache&&) = delete;
+	GeneratedModelDiskCache& operator=(const GeneratedModelDiskCache&) = delete;
+	GeneratedModelDiskCache& operator=(GeneratedModelDiskCache&&) = delete;
+	~GeneratedModelDiskCache() = default;
+
+	GeneratedModelSPtr get(uint64_t key);
+	bool put(uint64_t key, const GeneratedModel& model);
+
+	std::filesystem::path getPath(uint64_t key) const;
+	Stats getStats() const;
+
+private:
+	const std::filesystem::path mDirectory;
+
+	std::atomic<size_t> mHits{0};
+	std::atomic<size_t> mMisses{0};
+	std::atomic<size_t> mWrites{0};
+	std::atomic<size_t> mFailedWrites{0};
+};
@@ -0,0 +1,349 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HoleBridging.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+using Vec2 = std::array<double, 2>;
+using Vec3 = std::array<double, 3>;
+
+// a corner is identified by its position in the per-corner arrays (vertexIndices, normalIndices)
+using Loop = std::vector<size_t>;
+
+class Faces {
+public:
+	Faces(const double* vtx, size_t vtxSize, const uint32_t* counts, size_t countsSize, const uint32_t* vertexIndices)
+	    : mVtx(vtx), mVtxSize(vtxSize), mVertexIndices(vertexIndices), mStarts(countsSize + 1, 0) {
+		for (size_t fi = 0; fi < countsSize; fi++) {
+			mStarts[fi + 1] = mStarts[fi] + counts[fi];
+			mCornerFaces.insert(mCornerFaces.end(), counts[fi], fi);
+		}
+	}
+
+	size_t getCornerCount() const {
+		return mStarts.back();
+	}
+
+	Loop getLoop(size_t face) const {
+		Loop loop(mStarts[face + 1] - mStarts[face]);
+		std::iota(loop.begin(), loop.end(), mStarts[face]);
+		return loop;
+	}
+
+	size_t getFace(size_t corner) const {
+		return mCornerFaces[corner];
+	}
+
+	// position of the corner within its face
+	size_t getLocalIndex(size_t corner) const {
+		return corner - mStarts[mCornerFaces[corner]];
+	}
+
+	bool hasValidVertices() const {
+		for (size_t ci = 0; ci < getCornerCount(); ci++) {
+			if (size_t(mVertexIndices[ci]) * 3 + 2 >= mVtxSize)
+				return false;
+		}
+		return true;
+	}
+
+	Vec3 getPosition(size_t corner) const {
+		const double* p = mVtx + size_t(mVertexIndices[corner]) * 3;
+		return {p[0], p[1], p[2]};
+	}
+
+	// Newell's method, not normalized
+	Vec3 getNormal(const Loop& loop) const {
+		Vec3 n = {0.0, 0.0, 0.0};
+		for (size_t i = 0; i < loop.size(); i++) {
+			const Vec3 a = getPosition(loop[i]);
+			const Vec3 b = getPosition(loop[(i + 1) % loop.size()]);
+			n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+			n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+			n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+		}
+		return n;
+	}
+
+	double getSquaredDistance(size_t cornerA, size_t cornerB) const {
+		const Vec3 a = getPosition(cornerA);
+		const Vec3 b = getPosition(cornerB);
+		return (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+	}
+
+private:
+	const double* mVtx;
+	size_t mVtxSize;
+	const uint32_t* mVertexIndices;
+	std::vector<size_t> mStarts;      // first corner per face
+	std::vector<size_t> mCornerFaces; // face per corner
+};
+
+// drops the dominant axis of the face normal, i.e. projects the face onto the best fitting coordinate plane
+class Projection {
+public:
+	explicit Projection(const Vec3& normal) {
+		const Vec3 a = {std::abs(normal[0]), std::abs(normal[1]), std::abs(normal[2])};
+		const size_t axis = (a[0] >= a[1] && a[0] >= a[2]) ? 0 : ((a[1] >= a[2]) ? 1 : 2);
+		mU = (axis + 1) % 3;
+		mV = (axis + 2) % 3;
+	}
+
+	Vec2 operator()(const Vec3& p) const {
+		return {p[mU], p[mV]};
+	}
+
+private:
+	size_t mU;
+	size_t mV;
+};
+
+double cross(const Vec2& o, const Vec2& a, const Vec2& b) {
+	return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+}
+
+// q is collinear with p and r, checks if it lies within their bounding box
+bool isWithin(const Vec2& p, const Vec2& q, const Vec2& r) {
+	return q[0] >= std::min(p[0], r[0]) && q[0] <= std::max(p[0], r[0]) && q[1] >= std::min(p[1], r[1]) &&
+	       q[1] <= std::max(p[1], r[1]);
+}
+
+// touching counts as intersecting
+bool intersects(const Vec2& p1, const Vec2& p2, const Vec2& q1, const Vec2& q2) {
+	const double d1 = cross(q1, q2, p1);
+	const double d2 = cross(q1, q2, p2);
+	const double d3 = cross(p1, p2, q1);
+	const double d4 = cross(p1, p2, q2);
+	if (((d1 > 0.0 && d2 < 0.0) || (d1 < 0.0 && d2 > 0.0)) && ((d3 > 0.0 && d4 < 0.0) || (d3 < 0.0 && d4 > 0.0)))
+		return true;
+	return (d1 == 0.0 && isWithin(q1, p1, q2)) || (d2 == 0.0 && isWithin(q1, p2, q2)) ||
+	       (d3 == 0.0 && isWithin(p1, q1, p2)) || (d4 == 0.0 && isWithin(p1, q2, p2));
+}
+
+// checks if the bridge from a to b crosses (or touches) an edge of the loops, edges at a or b are ignored
+bool crosses(const Faces& faces, const Projection& proj, size_t a, size_t b, const std::vector<const Loop*>& loops) {
+	const Vec2 pa = proj(faces.getPosition(a));
+	const Vec2 pb = proj(faces.getPosition(b));
+	for (const Loop* loop : loops) {
+		for (size_t i = 0; i < loop->size(); i++) {
+			const Vec2 q1 = proj(faces.getPosition((*loop)[i]));
+			const Vec2 q2 = proj(faces.getPosition((*loop)[(i + 1) % loop->size()]));
+			if (q1 == pa || q1 == pb || q2 == pa || q2 == pb)
+				continue;
+			if (intersects(pa, pb, q1, q2))
+				return true;
+		}
+	}
+	return false;
+}
+
+// connects the hole to the closest corner of the outer loop such that the bridge does not cross the outer loop
+// (including the holes bridged so far), the hole itself or the remaining holes. The hole is traversed with opposite
+// orientation. Returns false if there is no such bridge.
+bool bridge(const Faces& faces, const Projection& proj, Loop& outer, Loop hole,
+            const std::vector<const Loop*>& remaining) {
+	const Vec3 no = faces.getNormal(outer);
+	const Vec3 nh = faces.getNormal(hole);
+	if (no[0] * nh[0] + no[1] * nh[1] + no[2] * nh[2] > 0.0)
+		std::reverse(hole.begin(), hole.end());
+
+	// the corners of earlier bridges appear twice in the outer loop, we do not attach to them to keep the
+	// bridges from overlapping
+	std::vector<size_t> sortedOuter = outer;
+	std::sort(sortedOuter.begin(), sortedOuter.end());
+	auto isBridgeCorner = [&sortedOuter](size_t corner) {
+		const auto r = std::equal_range(sortedOuter.begin(), sortedOuter.end(), corner);
+		return std::distance(r.first, r.second) > 1;
+	};
+
+	struct Candidate {
+		double dist;
+		size_t outer;
+		size_t hole;
+	};
+	std::vector<Candidate> candidates;
+	candidates.reserve(outer.size() * hole.size());
+	for (size_t oi = 0; oi < outer.size(); oi++) {
+		if (isBridgeCorner(outer[oi]))
+			continue;
+		for (size_t hi = 0; hi < hole.size(); hi++)
+			candidates.push_back({faces.getSquaredDistance(outer[oi], hole[hi]), oi, hi});
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+		return a.dist < b.dist;
+	});
+
+	std::vector<const Loop*> obstacles = {&outer, &hole};
+	obstacles.insert(obstacles.end(), remaining.begin(), remaining.end());
+
+	const auto best = std::find_if(candidates.begin(), candidates.end(), [&](const Candidate& c) {
+		return !crosses(faces, proj, outer[c.outer], hole[c.hole], obstacles);
+	});
+	if (best == candidates.end())
+		return false;
+
+	// outer[0..best.outer], hole starting at best.hole (closed), back to outer[best.outer], rest of outer
+	Loop bridged;
+	bridged.reserve(outer.size() + hole.size() + 2);
+	bridged.insert(bridged.end(), outer.begin(), outer.begin() + best->outer + 1);
+	for (size_t i = 0; i <= hole.size(); i++)
+		bridged.push_back(hole[(best->hole + i) % hole.size()]);
+	bridged.insert(bridged.end(), outer.begin() + best->outer, outer.end());
+	outer.swap(bridged);
+	return true;
+}
+
+} // namespace
+
+namespace HoleBridging {
+
+bool bridgeHoles(BridgedFaces& result, const double* vtx, size_t vtxSize, const uint32_t* counts, size_t countsSize,
+                 const uint32_t* holeCounts, size_t holeCountsSize, const uint32_t* holeIndices,
+                 size_t holeIndicesSize, const uint32_t* vertexIndices, size_t vertexIndicesSize,
+                 const uint32_t* normalIndices, size_t normalIndicesSize, uint32_t const* const* uvCounts,
+                 size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
+                 uint32_t uvSets, const uint32_t* faceRanges, size_t faceRangesSize) {
+	if (holeCountsSize != countsSize)
+		return false;
+
+	const Faces faces(vtx, vtxSize, counts, countsSize, vertexIndices);
+	if (faces.getCornerCount() != vertexIndicesSize || !faces.hasValidVertices())
+		return false;
+
+	const bool hasNormals = (normalIndicesSize > 0);
+	if (hasNormals && normalIndicesSize != vertexIndicesSize)
+		return false;
+
+	// -- uvs: per set, each face has either no uvs or one per corner
+	std::vector<std::vector<size_t>> uvStarts(uvSets);
+	for (uint32_t uvSet = 0; uvSet < uvSets; uvSet++) {
+		if (uvCountsSizes[uvSet] == 0)
+			continue;
+		if (uvCountsSizes[uvSet] != countsSize)
+			return false;
+		std::vector<size_t>& starts = uvStarts[uvSet];
+		starts.resize(countsSize + 1, 0);
+		for (size_t fi = 0; fi < countsSize; fi++) {
+			const uint32_t uvCount = uvCounts[uvSet][fi];
+			if (uvCount != 0 && uvCount != counts[fi])
+				return false;
+			starts[fi + 1] = starts[fi] + uvCount;
+		}
+		if (starts.back() != uvIndicesSizes[uvSet])
+			return false;
+	}
+	auto hasUVs = [&](uint32_t uvSet, size_t face) {
+		return !uvStarts[uvSet].empty() && uvCounts[uvSet][face] > 0;
+	};
+
+	// -- holes: each hole belongs to exactly one face and has no holes itself
+	std::vector<bool> isHole(countsSize, false);
+	size_t holeIndexPos = 0;
+	for (size_t fi = 0; fi < countsSize; fi++) {
+		for (uint32_t hi = 0; hi < holeCounts[fi]; hi++, holeIndexPos++) {
+			if (holeIndexPos >= holeIndicesSize)
+				return false;
+			const uint32_t hole = holeIndices[holeIndexPos];
+			if (hole >= countsSize || hole == fi || isHole[hole] || holeCounts[hole] > 0)
+				return false;
+			for (uint32_t uvSet = 0; uvSet < uvSets; uvSet++) {
+				if (hasUVs(uvSet, hole) != hasUVs(uvSet, fi))
+					return false;
+			}
+			isHole[hole] = true;
+		}
+	}
+
+	// -- bridge the holes into their faces and drop the hole faces
+	result = BridgedFaces();
+	result.counts.reserve(countsSize);
+	result.vertexIndices.reserve(vertexIndicesSize + 2 * holeIndicesSize);
+	if (hasNormals)
+		result.normalIndices.reserve(normalIndicesSize + 2 * holeIndicesSize);
+	result.uvCounts.resize(uvSets);
+	result.uvIndices.resize(uvSets);
+
+	std::vector<uint32_t> newFaceIndices(countsSize + 1, 0); // number of remaining faces before each face
+	holeIndexPos = 0;
+	for (size_t fi = 0; fi < countsSize; fi++) {
+		newFaceIndices[fi + 1] = newFaceIndices[fi] + (isHole[fi] ? 0 : 1);
+
+		Loop loop = faces.getLoop(fi);
+		if (holeCounts[fi] > 0) {
+			// like the hole elimination of ear clipping: the holes are bridged from right to left
+			const Projection proj(faces.getNormal(loop));
+			std::vector<Loop> holes;
+			std::vector<double> maxX;
+			for (uint32_t hi = 0; hi < holeCounts[fi]; hi++, holeIndexPos++) {
+				holes.push_back(faces.getLoop(holeIndices[holeIndexPos]));
+				double x = std::numeric_limits<double>::lowest();
+				for (const size_t corner : holes.back())
+					x = std::max(x, proj(faces.getPosition(corner))[0]);
+				maxX.push_back(x);
+			}
+			std::vector<size_t> order(holes.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&maxX](size_t a, size_t b) { return maxX[a] > maxX[b]; });
+
+			std::vector<const Loop*> remaining;
+			for (size_t oi = 0; oi < order.size(); oi++) {
+				remaining.clear();
+				for (size_t ri = oi + 1; ri < order.size(); ri++)
+					remaining.push_back(&holes[order[ri]]);
+				if (!bridge(faces, proj, loop, holes[order[oi]], remaining))
+					return false; // e.g. overlapping holes, let buildHoles deal with it
+			}
+		}
+		if (isHole[fi])
+			continue;
+
+		result.counts.push_back(static_cast<uint32_t>(loop.size()));
+		for (const size_t corner : loop) {
+			result.vertexIndices.push_back(vertexIndices[corner]);
+			if (hasNormals)
+				result.normalIndices.push_back(normalIndices[corner]);
+		}
+
+		for (uint32_t uvSet = 0; uvSet < uvSets; uvSet++) {
+			if (uvStarts[uvSet].empty())
+				continue;
+			const bool faceHasUVs = hasUVs(uvSet, fi);
+			result.uvCounts[uvSet].push_back(faceHasUVs ? static_cast<uint32_t>(loop.size()) : 0);
+			if (!faceHasUVs)
+				continue;
+			for (const size_t corner : loop) {
+				const size_t uvPos = uvStarts[uvSet][faces.getFace(corner)] + faces.getLocalIndex(corner);
+				result.uvIndices[uvSet].push_back(uvIndices[uvSet][uvPos]);
+			}
+		}
+	}
+
+	result.faceRanges.resize(faceRangesSize);
+	for (size_t fri = 0; fri < faceRangesSize; fri++)
+		result.faceRanges[fri] = newFaceIndices[std::min<size_t>(faceRanges[fri], countsSize)];
+
+	return true;
+}
+
+} // namespace HoleBridging
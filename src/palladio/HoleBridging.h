@@ -0,0 +1,54 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "PalladioMain.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace HoleBridging {
+
+/**
+ * faces with their holes merged in: each face with holes is connected to its holes by a pair of bridge edges
+ * (like the "holes with bridges" of Houdini's buildHoles) and the hole faces are removed.
+ * The per-corner indices (vertices, normals, uvs) are carried along, the face ranges refer to the remaining faces.
+ */
+struct BridgedFaces {
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> vertexIndices;
+	std::vector<uint32_t> normalIndices;
+	std::vector<std::vector<uint32_t>> uvCounts; // per uv set
+	std::vector<std::vector<uint32_t>> uvIndices;
+	std::vector<uint32_t> faceRanges;
+};
+
+/**
+ * takes the arguments of HoudiniCallbacks::add, returns false if the faces cannot be bridged (e.g. nested holes or
+ * per-corner data which does not match the faces), the caller then has to fall back to Houdini's buildHoles
+ */
+PLD_TEST_EXPORTS_API bool bridgeHoles(BridgedFaces& result, const double* vtx, size_t vtxSize, const uint32_t* counts,
+                                      size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
+                                      const uint32_t* holeIndices, size_t holeIndicesSize,
+                                      const uint32_t* vertexIndices, size_t vertexIndicesSize,
+                                      const uint32_t* normalIndices, size_t normalIndicesSize,
+                                      uint32_t const* const* uvCounts, size_t const* uvCountsSizes,
+                                      uint32_t const* const* uvIndices, size_t const* uvIndicesSizes, uint32_t uvSets,
+                                      const uint32_t* faceRanges, size_t faceRangesSize);
+
+} // namespace HoleBridging
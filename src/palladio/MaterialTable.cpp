@@ -0,0 +1,68 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MaterialTable.h"
+#include "AttributeConversion.h"
+#include "ContentHash.h"
+
+void MaterialTable::read(const GU_Detail* detail) {
+	const GA_ROHandleDictA handle(detail->findAttribute(GA_ATTRIB_DETAIL, PLD_MATERIALS));
+	if (handle.isInvalid())
+		return;
+
+	UT_Array<UT_OptionsHolder> materials;
+	handle.get(GA_DETAIL_OFFSET, materials);
+
+	std::lock_guard<std::mutex> guard(mMutex);
+	for (const UT_OptionsHolder& options : materials)
+		add(options);
+}
+
+int32_t MaterialTable::add(const prt::AttributeMap* material) {
+	const uint64_t hash = ContentHash().add(material).get();
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		const auto it = mIndices.find(hash);
+		if (it != mIndices.end())
+			return it->second;
+	}
+
+	// materials read from the detail are only known by their content
+	const UT_OptionsHolder options = AttributeConversion::toOptions(material);
+
+	std::lock_guard<std::mutex> guard(mMutex);
+	const int32_t index = add(options);
+	mIndices.emplace(hash, index);
+	return index;
+}
+
+int32_t MaterialTable::add(const UT_OptionsHolder& options) {
+	const auto it = mOptionsIndices.find(options);
+	if (it != mOptionsIndices.end())
+		return it->second;
+
+	const auto index = static_cast<int32_t>(mMaterials.size());
+	mMaterials.append(options);
+	mOptionsIndices.emplace(options, index);
+	return index;
+}
+
+void MaterialTable::write(GU_Detail* detail) const {
+	std::lock_guard<std::mutex> guard(mMutex);
+	GA_RWHandleDictA handle(detail->addDictArray(GA_ATTRIB_DETAIL, PLD_MATERIALS));
+	if (handle.isValid())
+		handle.set(GA_DETAIL_OFFSET, mMaterials);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "prt/AttributeMap.h"
+
+#include "GU/GU_Detail.h"
+#include "UT/UT_Options.h"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// detail attribute with the dictionaries of the distinct materials, see MaterialTable
+const UT_String PLD_MATERIALS = "materials";
+
+// primitive attribute with the index of the primitive's material in PLD_MATERIALS
+const UT_String PLD_MATERIAL_INDEX = "materialIndex";
+
+/**
+ * compact material mode: each distinct material of a cook is stored once in a detail attribute and the primitives
+ * only carry its index, instead of a copy of all material attributes per primitive
+ */
+class MaterialTable {
+public:
+	// continues the table of the detail, i.e. the primitives kept from the last cook keep their indices
+	void read(const GU_Detail* detail);
+
+	// thread-safe, returns the index of the material (materials with the same content share their index)
+	int32_t add(const prt::AttributeMap* material);
+
+	void write(GU_Detail* detail) const;
+
+private:
+	struct OptionsHash {
+		size_t operator()(const UT_OptionsHolder& options) const {
+			return static_cast<size_t>(options.hash());
+		}
+	};
+
+	int32_t add(const UT_OptionsHolder& options); // mMutex must be locked
+
+	mutable std::mutex mMutex;
+	std::unordered_map<uint64_t, int32_t> mIndices; // by content hash of the attribute map, avoids the conversion
+	std::unordered_map<UT_OptionsHolder, int32_t, OptionsHash> mOptionsIndices;
+	UT_Array<UT_OptionsHolder> mMaterials;
+};
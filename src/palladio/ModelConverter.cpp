@@ -16,12 +16,19 @@
 
 #include "ModelConverter.h"
 #include "AttributeConversion.h"
+#include "HoleBridging.h"
 #include "LogHandler.h"
 #include "MultiWatch.h"
 #include "ShapeConverter.h"
 
 #include "GU/GU_HoleInfo.h"
+#include "GU/GU_PackedGeometry.h"
+#include "GU/GU_PrimPacked.h"
+#include "UT/UT_BoundingBox.h"
+#include "UT/UT_Matrix3.h"
+#include "UT/UT_Matrix4.h"
 
+#include <algorithm>
 #include <mutex>
 #include <variant>
 
@@ -31,61 +38,170 @@ constexpr bool DBG = false;
 
 using UTVector3FVector = std::vector<UT_Vector3F>;
 
-UTVector3FVector convertVertices(const double* vtx, size_t vtxSize) {
-	UTVector3FVector utPoints;
-	utPoints.reserve(vtxSize / 3);
+void appendVertices(UTVector3FVector& utPoints, const double* vtx, size_t vtxSize) {
 	for (size_t pi = 0; pi < vtxSize; pi += 3) {
 		const auto x = static_cast<fpreal32>(vtx[pi + 0]);
 		const auto y = static_cast<fpreal32>(vtx[pi + 1]);
 		const auto z = static_cast<fpreal32>(vtx[pi + 2]);
 		utPoints.emplace_back(x, y, z);
 	}
-	return utPoints;
 }
 
-void setVertexNormals(GA_RWHandleV3& handle, const GA_Detail::OffsetMarker& marker, const double* nrm, size_t nrmSize,
-                      const uint32_t* indices, size_t indicesSize) {
+void setVertexNormals(GA_RWHandleV3& handle, const GU_Detail* detail, const GA_Range& primRange, const double* nrm,
+                      size_t nrmSize, const uint32_t* indices, size_t indicesSize) {
 	uint32_t vi = 0;
-	for (GA_Iterator it(marker.vertexRange()); !it.atEnd(); ++it, ++vi) {
-		assert(vi < indicesSize);
-		const auto nrmIdx = indices[vi];
-		const auto nrmPos = nrmIdx * 3;
-		assert(nrmPos + 2 < nrmSize);
-		const auto nx = static_cast<fpreal32>(nrm[nrmPos + 0]);
-		const auto ny = static_cast<fpreal32>(nrm[nrmPos + 1]);
-		const auto nz = static_cast<fpreal32>(nrm[nrmPos + 2]);
-		handle.set(it.getOffset(), UT_Vector3F(nx, ny, nz));
+	for (GA_Iterator pit(primRange); !pit.atEnd(); ++pit) {
+		const GA_Primitive* prim = detail->getPrimitive(pit.getOffset());
+		for (GA_Iterator it(prim->getVertexRange()); !it.atEnd(); ++it, ++vi) {
+			assert(vi < indicesSize);
+			const auto nrmIdx = indices[vi];
+			const auto nrmPos = nrmIdx * 3;
+			assert(nrmPos + 2 < nrmSize);
+			const auto nx = static_cast<fpreal32>(nrm[nrmPos + 0]);
+			const auto ny = static_cast<fpreal32>(nrm[nrmPos + 1]);
+			const auto nz = static_cast<fpreal32>(nrm[nrmPos + 2]);
+			handle.set(it.getOffset(), UT_Vector3F(nx, ny, nz));
+		}
 	}
 }
 
-std::mutex mDetailMutex; // guard the houdini detail object (and the hole groups)
+AttributeMapNOPtrVector toPtrVec(const AttributeMapVector& maps) {
+	AttributeMapNOPtrVector ptrs(maps.size());
+	std::transform(maps.begin(), maps.end(), ptrs.begin(), [](const AttributeMapUPtr& m) { return m.get(); });
+	return ptrs;
+}
 
-GA_Offset createPrimitives(GU_Detail* mDetail, PrimitiveGroups& holeGroups, GroupCreation gc, const wchar_t* name,
-                           const double* vtx, size_t vtxSize, const double* nrm, size_t nrmSize, const uint32_t* counts,
-                           size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
-                           const uint32_t* holeIndices, size_t holeIndicesSize, const uint32_t* vertexIndices,
-                           size_t vertexIndicesSize, const uint32_t* normalIndices, size_t normalIndicesSize,
-                           double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
-                           size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
-                           uint32_t uvSets) {
-	WA("all");
+// the encoder owns the attribute maps only for the duration of the callback
+AttributeMapVector copyAttributeMaps(const prt::AttributeMap* const* maps, size_t count) {
+	AttributeMapVector copies(count);
+	for (size_t i = 0; i < count; i++) {
+		if (maps[i] == nullptr)
+			continue;
+		const AttributeMapBuilderUPtr amb(prt::AttributeMapBuilder::createFromAttributeMap(maps[i]));
+		copies[i].reset(amb->createAttributeMap());
+	}
+	return copies;
+}
 
-	// -- create primitives
-	const GA_Detail::OffsetMarker marker(*mDetail);
-	const UTVector3FVector utPoints = convertVertices(vtx, vtxSize);
+// the data and size pointer arrays of the per-uv-set vectors, as taken by the PRT callback style functions
+template <typename T>
+struct ArrayPtrs {
+	std::vector<const T*> ptrs;
+	std::vector<size_t> sizes;
+
+	explicit ArrayPtrs(const std::vector<std::vector<T>>& arrays) : ptrs(arrays.size()), sizes(arrays.size()) {
+		for (size_t i = 0; i < arrays.size(); i++) {
+			ptrs[i] = arrays[i].data();
+			sizes[i] = arrays[i].size();
+		}
+	}
+};
+
+bool hasHoles(const uint32_t* holeCounts, size_t holeCountsSize) {
+	return std::any_of(holeCounts, holeCounts + holeCountsSize, [](uint32_t c) { return c > 0; });
+}
+
+// merges the holes of the mesh into their faces, see HoleBridging::bridgeHoles
+bool bridgeHoles(GeneratedMesh& mesh) {
+	const auto uvSets = static_cast<uint32_t>(mesh.uvCounts.size());
+	const ArrayPtrs<uint32_t> uvCounts(mesh.uvCounts);
+	const ArrayPtrs<uint32_t> uvIndices(mesh.uvIndices);
+
+	HoleBridging::BridgedFaces bf;
+	if (!HoleBridging::bridgeHoles(bf, mesh.vtx.data(), mesh.vtx.size(), mesh.counts.data(), mesh.counts.size(),
+	                               mesh.holeCounts.data(), mesh.holeCounts.size(), mesh.holeIndices.data(),
+	                               mesh.holeIndices.size(), mesh.vertexIndices.data(), mesh.vertexIndices.size(),
+	                               mesh.normalIndices.data(), mesh.normalIndices.size(), uvCounts.ptrs.data(),
+	                               uvCounts.sizes.data(), uvIndices.ptrs.data(), uvIndices.sizes.data(), uvSets,
+	                               mesh.faceRanges.data(), mesh.faceRanges.size()))
+		return false;
+
+	mesh.counts = std::move(bf.counts);
+	mesh.vertexIndices = std::move(bf.vertexIndices);
+	mesh.normalIndices = std::move(bf.normalIndices);
+	mesh.uvCounts = std::move(bf.uvCounts);
+	mesh.uvIndices = std::move(bf.uvIndices);
+	mesh.faceRanges = std::move(bf.faceRanges);
+	mesh.holeCounts.clear();
+	mesh.holeIndices.clear();
+	return true;
+}
+
+GeneratedMesh copyMesh(const double* vtx, size_t vtxSize, const double* nrm, size_t nrmSize, const uint32_t* counts,
+                       size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
+                       const uint32_t* holeIndices, size_t holeIndicesSize, const uint32_t* vertexIndices,
+                       size_t vertexIndicesSize, const uint32_t* normalIndices, size_t normalIndicesSize,
+                       double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
+                       size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
+                       uint32_t uvSets, const uint32_t* faceRanges, size_t faceRangesSize,
+                       const prt::AttributeMap* const* materials, const prt::AttributeMap* const* reports,
+                       const prt::AttributeMap* const* shapeAttributes, const int32_t* shapeIDs) {
+	GeneratedMesh mesh;
+	mesh.vtx.assign(vtx, vtx + vtxSize);
+	mesh.nrm.assign(nrm, nrm + nrmSize);
+	mesh.counts.assign(counts, counts + countsSize);
+	mesh.holeCounts.assign(holeCounts, holeCounts + holeCountsSize);
+	mesh.holeIndices.assign(holeIndices, holeIndices + holeIndicesSize);
+	mesh.vertexIndices.assign(vertexIndices, vertexIndices + vertexIndicesSize);
+	mesh.normalIndices.assign(normalIndices, normalIndices + normalIndicesSize);
+	for (uint32_t uvSet = 0; uvSet < uvSets; uvSet++) {
+		mesh.uvs.emplace_back(uvs[uvSet], uvs[uvSet] + uvsSizes[uvSet]);
+		mesh.uvCounts.emplace_back(uvCounts[uvSet], uvCounts[uvSet] + uvCountsSizes[uvSet]);
+		mesh.uvIndices.emplace_back(uvIndices[uvSet], uvIndices[uvSet] + uvIndicesSizes[uvSet]);
+	}
+	mesh.faceRanges.assign(faceRanges, faceRanges + faceRangesSize);
+	const size_t numFaceRanges = (faceRangesSize > 0) ? faceRangesSize - 1 : 0;
+	if (materials != nullptr)
+		mesh.materials = copyAttributeMaps(materials, numFaceRanges);
+	if (reports != nullptr)
+		mesh.reports = copyAttributeMaps(reports, numFaceRanges);
+	if (shapeAttributes != nullptr)
+		mesh.shapeAttributes = copyAttributeMaps(shapeAttributes, numFaceRanges);
+	mesh.shapeIDs.assign(shapeIDs, shapeIDs + numFaceRanges);
+	return mesh;
+}
+
+GA_Offset buildPrimitives(GU_Detail* detail, const double* vtx, size_t vtxSize, const uint32_t* counts,
+                          size_t countsSize, const uint32_t* vertexIndices) {
+	UTVector3FVector utPoints;
+	utPoints.reserve(vtxSize / 3);
+	appendVertices(utPoints, vtx, vtxSize);
 	const GEO_PolyCounts geoPolyCounts = [&counts, &countsSize]() {
 		GEO_PolyCounts pc;
 		for (size_t ci = 0; ci < countsSize; ci++)
 			pc.append(counts[ci]);
 		return pc;
 	}();
-	const GA_Offset primStartOffset = GU_PrimPoly::buildBlock(mDetail, utPoints.data(), utPoints.size(), geoPolyCounts,
-	                                                          reinterpret_cast<const int*>(vertexIndices));
+	return GU_PrimPoly::buildBlock(detail, utPoints.data(), utPoints.size(), geoPolyCounts,
+	                               reinterpret_cast<const int*>(vertexIndices));
+}
+
+// the group might already exist in incremental mode
+void addToPrimitiveGroup(GU_Detail* detail, const wchar_t* name, const GA_Range& primRange) {
+	const std::string nName = toOSNarrowFromUTF16(name);
+	GA_PrimitiveGroup* primGroup = detail->findPrimitiveGroup(nName.c_str());
+	if (primGroup == nullptr)
+		primGroup = detail->newPrimitiveGroup(nName.c_str());
+	primGroup->addRange(primRange);
+}
+
+// sets normals, uvs and groups of the primitives previously built for the mesh, starting at primStartOffset
+void setPrimitiveData(GU_Detail* mDetail, GA_Offset primStartOffset, PrimitiveGroups& holeGroups, GroupCreation gc,
+                      const wchar_t* name, const double* nrm, size_t nrmSize, const uint32_t* counts,
+                      size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
+                      const uint32_t* holeIndices, size_t holeIndicesSize, size_t vertexIndicesSize,
+                      const uint32_t* normalIndices, size_t normalIndicesSize, double const* const* uvs,
+                      size_t const* uvsSizes, uint32_t const* const* uvCounts, size_t const* uvCountsSizes,
+                      uint32_t const* const* uvIndices, size_t const* uvIndicesSizes, uint32_t uvSets) {
+	WA("all");
+
+	const GA_Range primRange(mDetail->getPrimitiveMap(), primStartOffset,
+	                         primStartOffset + static_cast<GA_Offset>(countsSize));
 
 	// -- add vertex normals
 	if (nrmSize > 0) {
 		GA_RWHandleV3 nrmh(mDetail->addNormalAttribute(GA_ATTRIB_VERTEX, GA_STORE_REAL32));
-		setVertexNormals(nrmh, marker, nrm, vertexIndicesSize, normalIndices, normalIndicesSize);
+		setVertexNormals(nrmh, mDetail, primRange, nrm, vertexIndicesSize, normalIndices, normalIndicesSize);
 	}
 
 	// -- add texture coordinates
@@ -112,7 +228,7 @@ GA_Offset createPrimitives(GU_Detail* mDetail, PrimitiveGroups& holeGroups, Grou
 
 			size_t fi = 0;
 			size_t uvi = 0;
-			for (GA_Iterator pit(marker.primitiveRange()); !pit.atEnd(); ++pit, ++fi) {
+			for (GA_Iterator pit(primRange); !pit.atEnd(); ++pit, ++fi) {
 				GA_Primitive* prim = mDetail->getPrimitive(pit.getOffset());
 				if (DBG)
 					LOG_DBG << "   fi = " << fi << ": prim vtx cnt = " << prim->getVertexCount()
@@ -159,45 +275,441 @@ GA_Offset createPrimitives(GU_Detail* mDetail, PrimitiveGroups& holeGroups, Grou
 	}
 
 	// -- optionally create primitive groups
-	if (gc == GroupCreation::PRIMCLS) {
-		const std::string nName = toOSNarrowFromUTF16(name);
-		auto& elemGroupTable = mDetail->getElementGroupTable(GA_ATTRIB_PRIMITIVE);
-		GA_PrimitiveGroup* primGroup = static_cast<GA_PrimitiveGroup*>(elemGroupTable.newGroup(nName.c_str(), false));
-		primGroup->addRange(marker.primitiveRange());
-	}
+	if (gc == GroupCreation::PRIMCLS)
+		addToPrimitiveGroup(mDetail, name, primRange);
+}
 
-	return primStartOffset;
+// appends the primitives of src to dst, the private shape hashes are copied explicitly as GU_Detail::merge is not
+// guaranteed to carry over attributes of private scope (incremental mode depends on them)
+void mergeDetail(GU_Detail& dst, const GU_Detail& src) {
+	const GA_ROHandleT<int64> srcHashes(src.findAttribute(GA_ATTRIB_PRIMITIVE, GA_SCOPE_PRIVATE, PLD_SHAPE_HASH));
+	const GA_Size dstPrimitives = dst.getNumPrimitives();
+	dst.merge(src);
+	if (srcHashes.isInvalid())
+		return;
+
+	GA_RWHandleT<int64> dstHashes(dst.addIntTuple(GA_ATTRIB_PRIMITIVE, GA_SCOPE_PRIVATE, PLD_SHAPE_HASH, 1,
+	                                              GA_Defaults(0), nullptr, nullptr, GA_STORE_INT64));
+	GA_Index dstIndex = dstPrimitives; // the merged primitives are appended in their order in src
+	for (GA_Iterator it(src.getPrimitiveRange()); !it.atEnd(); ++it, ++dstIndex)
+		dstHashes.set(dst.primitiveOffset(dstIndex), srcHashes.get(*it));
 }
 
 } // namespace
 
-ModelConverter::ModelConverter(GU_Detail* detail, GroupCreation gc, std::vector<prt::Status>& statuses,
-                               UT_AutoInterrupt* autoInterrupt)
-    : mDetail(detail), mGroupCreation(gc), mStatuses(statuses), mAutoInterrupt(autoInterrupt) {}
+ModelConverter::ModelConverter(GU_Detail* detail, std::mutex& detailMutex, GroupCreation gc,
+                               std::vector<prt::Status>& statuses, const CancellationToken* cancellation,
+                               const std::vector<uint64_t>* shapeHashes, GeneratedModels* generatedModels,
+                               const PrimitiveCreation& primitiveCreation)
+    : mTargetDetail(detail), mTargetDetailMutex(detailMutex),
+      mStagingDetail(primitiveCreation.stageGeometry ? new GU_Detail() : nullptr),
+      mDetail(primitiveCreation.stageGeometry ? mStagingDetail.get() : detail), mToHoudini(mDetail), mGroupCreation(gc),
+      mStatuses(statuses), mCancellation(cancellation), mShapeHashes(shapeHashes), mGeneratedModels(generatedModels),
+      mPrimitiveCreation(primitiveCreation) {}
 
 void ModelConverter::buildHoles() {
 	// after all meshes have been added, we can run buildHoles (which might delete some prims)
+	std::lock_guard<std::mutex> guard(mStagingDetail ? mStagingMutex : mTargetDetailMutex);
 	for (PrimitiveGroupUPtr& group : mHoleGroups) {
 		mDetail->buildHoles(0.001f, 0.2f, 0, group.get());
 	}
+	mHoleGroups.clear(); // the temporary groups must not end up in the merged detail
 }
 
-void ModelConverter::add(const wchar_t* name, const double* vtx, size_t vtxSize, const double* nrm, size_t nrmSize,
-                         const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
-                         const uint32_t* holeIndices, size_t holeIndicesSize, const uint32_t* vertexIndices,
-                         size_t vertexIndicesSize, const uint32_t* normalIndices, size_t normalIndicesSize,
+void ModelConverter::mergeStagingDetails(ThreadPool& threadPool, std::vector<ModelConverterUPtr>& converters) {
+	WA("all");
+
+	std::vector<GU_Detail*> details;
+	for (const ModelConverterUPtr& mc : converters) {
+		if (mc->mStagingDetail && mc->mStagingDetail->getNumPrimitives() > 0)
+			details.push_back(mc->mStagingDetail.get());
+	}
+	if (details.empty())
+		return;
+
+	// merge neighbouring pairs concurrently until one staging detail is left, this keeps the primitive order
+	for (size_t step = 1; step < details.size(); step *= 2) {
+		const size_t numPairs = (details.size() + 2 * step - 1) / (2 * step);
+		threadPool.parallelFor(numPairs, [&details, step](size_t pi) {
+			const size_t dst = pi * 2 * step;
+			const size_t src = dst + step;
+			if (src < details.size()) {
+				mergeDetail(*details[dst], *details[src]);
+				details[src]->clearAndDestroy();
+			}
+		});
+	}
+
+	// all converters of one generate pass share the same target
+	std::lock_guard<std::mutex> guard(converters.front()->mTargetDetailMutex);
+	mergeDetail(*converters.front()->mTargetDetail, *details.front());
+	details.front()->clearAndDestroy();
+}
+
+void ModelConverter::beginChunk(size_t isOffset) {
+	mInitialShapeIndexOffset = isOffset;
+	mShapeAttributeBuilders.clear(); // shape IDs are only valid within one generate call
+}
+
+void ModelConverter::add(size_t isIndex, const wchar_t* name, const double* vtx, size_t vtxSize, const double* nrm,
+                         size_t nrmSize, const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts,
+                         size_t holeCountsSize, const uint32_t* holeIndices, size_t holeIndicesSize,
+                         const uint32_t* vertexIndices, size_t vertexIndicesSize, const uint32_t* normalIndices,
+                         size_t normalIndicesSize,
                          double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
                          size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
                          uint32_t uvSets, const uint32_t* faceRanges, size_t faceRangesSize,
                          const prt::AttributeMap** materials, const prt::AttributeMap** reports,
                          const int32_t* shapeIDs) {
-	// we need to protect mDetail, it is accessed by multiple generate threads
-	std::lock_guard<std::mutex> guard(mDetailMutex);
+	// the geometry of a cancelled cook is discarded, do not spend time on converting it
+	if (isCancelled())
+		return;
+
+	// implicit contract: the attr{Bool,Float,String} callbacks are called prior to ModelConverter::add
+	const AttributeMapVector shapeAttributes =
+	        getShapeAttributes(shapeIDs, (faceRangesSize > 1) ? faceRangesSize - 1 : 0);
+	const AttributeMapNOPtrVector shapeAttributePtrs = toPtrVec(shapeAttributes);
+	const prt::AttributeMap* const* shapeAttributesPtr =
+	        shapeAttributePtrs.empty() ? nullptr : shapeAttributePtrs.data();
+	auto copy = [&]() {
+		return std::make_shared<const GeneratedMesh>(
+		        copyMesh(vtx, vtxSize, nrm, nrmSize, counts, countsSize, holeCounts, holeCountsSize, holeIndices,
+		                 holeIndicesSize, vertexIndices, vertexIndicesSize, normalIndices, normalIndicesSize, uvs,
+		                 uvsSizes, uvCounts, uvCountsSizes, uvIndices, uvIndicesSizes, uvSets, faceRanges,
+		                 faceRangesSize, materials, reports, shapeAttributesPtr, shapeIDs));
+	};
+	GeneratedMeshSPtr meshCopy; // made at most once, shared by the deferred mesh and the generated model
+
+	if (mPrimitiveCreation.packPrimitives) {
+		// the encoder calls add once per initial shape, i.e. this is the complete model
+		auto addMeshes = [&](ModelConverter& packedConverter) {
+			packedConverter.addMesh(0, name, vtx, vtxSize, nrm, nrmSize, counts, countsSize, holeCounts,
+			                        holeCountsSize, holeIndices, holeIndicesSize, vertexIndices, vertexIndicesSize,
+			                        normalIndices, normalIndicesSize, uvs, uvsSizes, uvCounts, uvCountsSizes,
+			                        uvIndices, uvIndicesSizes, uvSets, faceRanges, faceRangesSize, materials, reports,
+			                        shapeAttributesPtr, GA_INVALID_OFFSET);
+		};
+		// the packed primitive only carries the reports and attributes of the first face range, the ones of all face
+		// ranges are on the primitives inside the packed geometry
+		const bool hasFaceRanges = (faceRangesSize > 1);
+		addPacked(mInitialShapeIndexOffset + isIndex, name, addMeshes,
+		          (hasFaceRanges && reports != nullptr) ? reports[0] : nullptr,
+		          (hasFaceRanges && shapeAttributesPtr != nullptr) ? shapeAttributesPtr[0] : nullptr);
+	}
+	else if (mPrimitiveCreation.deferPrimitives) {
+		// phase one: only collect the mesh, see createDeferredPrimitives
+		meshCopy = copy();
+		DeferredMesh deferredMesh{mInitialShapeIndexOffset + isIndex, name, meshCopy};
+		std::lock_guard<std::mutex> guard(mStagingMutex);
+		mDeferredMeshes.emplace_back(std::move(deferredMesh));
+	}
+	else {
+		addMesh(mInitialShapeIndexOffset + isIndex, name, vtx, vtxSize, nrm, nrmSize, counts, countsSize,
+		        holeCounts, holeCountsSize, holeIndices, holeIndicesSize, vertexIndices, vertexIndicesSize,
+		        normalIndices, normalIndicesSize, uvs, uvsSizes, uvCounts, uvCountsSizes, uvIndices, uvIndicesSizes,
+		        uvSets, faceRanges, faceRangesSize, materials, reports, shapeAttributesPtr, GA_INVALID_OFFSET);
+	}
+
+	// -- keep a copy for the generated model cache
+	if (mGeneratedModels != nullptr) {
+		std::shared_ptr<GeneratedModel>& model = (*mGeneratedModels)[mInitialShapeIndexOffset + isIndex];
+		if (!model)
+			model = std::make_shared<GeneratedModel>();
+		model->meshes.emplace_back(meshCopy ? std::move(meshCopy) : copy());
+	}
+}
+
+void ModelConverter::add(size_t isIndex, const wchar_t* name, const GeneratedModel& model) {
+	if (mPrimitiveCreation.packPrimitives) {
+		if (model.meshes.empty())
+			return;
+		auto addMeshes = [&](ModelConverter& packedConverter) {
+			for (const GeneratedMeshSPtr& mesh : model.meshes)
+				packedConverter.addMesh(0, name, *mesh, GA_INVALID_OFFSET);
+		};
+		const GeneratedMesh& first = *model.meshes.front(); // like above, only the first face range
+		addPacked(mInitialShapeIndexOffset + isIndex, name, addMeshes,
+		          first.reports.empty() ? nullptr : first.reports.front().get(),
+		          first.shapeAttributes.empty() ? nullptr : first.shapeAttributes.front().get());
+		return;
+	}
+
+	for (const GeneratedMeshSPtr& mesh : model.meshes)
+		addMesh(mInitialShapeIndexOffset + isIndex, name, *mesh, GA_INVALID_OFFSET);
+}
+
+void ModelConverter::addPrototype(uint64_t prototypeKey, const double* vtx, size_t vtxSize, const double* nrm,
+                                  size_t nrmSize, const uint32_t* counts, size_t countsSize,
+                                  const uint32_t* holeCounts, size_t holeCountsSize, const uint32_t* holeIndices,
+                                  size_t holeIndicesSize, const uint32_t* vertexIndices, size_t vertexIndicesSize,
+                                  const uint32_t* normalIndices, size_t normalIndicesSize, double const* const* uvs,
+                                  size_t const* uvsSizes, uint32_t const* const* uvCounts,
+                                  size_t const* uvCountsSizes, uint32_t const* const* uvIndices,
+                                  size_t const* uvIndicesSizes, uint32_t uvSets, const uint32_t* faceRanges,
+                                  size_t faceRangesSize, const prt::AttributeMap** materials) {
+	if (isCancelled())
+		return;
+
+	// the encoders of concurrent generate calls might report the same prototype
+	{
+		std::lock_guard<std::mutex> guard(mPrototypesMutex);
+		if (mPrototypes.count(prototypeKey) > 0)
+			return;
+	}
+
+	auto addMeshes = [&](ModelConverter& packedConverter) {
+		packedConverter.addMesh(0, L"", vtx, vtxSize, nrm, nrmSize, counts, countsSize, holeCounts, holeCountsSize,
+		                        holeIndices, holeIndicesSize, vertexIndices, vertexIndicesSize, normalIndices,
+		                        normalIndicesSize, uvs, uvsSizes, uvCounts, uvCountsSizes, uvIndices,
+		                        uvIndicesSizes, uvSets, faceRanges, faceRangesSize, materials, nullptr, nullptr,
+		                        GA_INVALID_OFFSET);
+	};
+	GU_DetailHandle prototype;
+	prototype.allocateAndSet(createPackedDetail(addMeshes).release());
+
+	std::lock_guard<std::mutex> guard(mPrototypesMutex);
+	mPrototypes.emplace(prototypeKey, prototype);
+}
+
+void ModelConverter::addInstances(size_t isIndex, const wchar_t* name, uint64_t prototypeKey,
+                                  const double* transformations, size_t instancesSize,
+                                  const prt::AttributeMap** reports, const int32_t* shapeIDs) {
+	if (isCancelled())
+		return;
+
+	GU_DetailHandle prototype;
+	{
+		std::lock_guard<std::mutex> guard(mPrototypesMutex);
+		const auto it = mPrototypes.find(prototypeKey);
+		if (it == mPrototypes.end()) {
+			LOG_WRN << "ignoring instances of unknown prototype " << prototypeKey;
+			return;
+		}
+		prototype = it->second;
+	}
+
+	const AttributeMapVector shapeAttributes = getShapeAttributes(shapeIDs, instancesSize);
+
+	std::lock_guard<std::mutex> guard(mStagingDetail ? mStagingMutex : mTargetDetailMutex);
+	for (size_t ii = 0; ii < instancesSize; ii++) {
+		GU_PrimPacked* packedPrim = GU_PackedGeometry::packGeometry(*mDetail, prototype);
+
+		// Houdini transforms row vectors, i.e. its matrix is the transpose of the column-major matrix from PRT
+		const double* m = transformations + 16 * ii;
+		UT_Matrix4D transformation;
+		for (int r = 0; r < 4; r++) {
+			for (int c = 0; c < 4; c++)
+				transformation(r, c) = m[r * 4 + c];
+		}
+		UT_Vector3D translation;
+		transformation.getTranslates(translation);
+		packedPrim->setLocalTransform(UT_Matrix3D(transformation));
+		mDetail->setPos3(packedPrim->getPointOffset(0), translation);
+
+		setPackedPrimitiveData(packedPrim->getMapOffset(), mInitialShapeIndexOffset + isIndex, name,
+		                       (reports != nullptr) ? reports[ii] : nullptr,
+		                       shapeAttributes.empty() ? nullptr : shapeAttributes[ii].get());
+	}
+}
+
+void ModelConverter::addPacked(size_t isIndex, const wchar_t* name,
+                               const std::function<void(ModelConverter&)>& addMeshes,
+                               const prt::AttributeMap* reports, const prt::AttributeMap* shapeAttributes) {
+	std::unique_ptr<GU_Detail> packedDetail = createPackedDetail(addMeshes);
+	if (packedDetail->getNumPrimitives() == 0)
+		return;
+
+	// the packed primitive sits at the center of its geometry, i.e. it is transformed around its own center
+	UT_BoundingBox bbox;
+	packedDetail->getBBox(&bbox);
+	const UT_Vector3 center = bbox.center();
+	GA_Offset ptoff;
+	GA_FOR_ALL_PTOFF(packedDetail.get(), ptoff) {
+		packedDetail->setPos3(ptoff, packedDetail->getPos3(ptoff) - center);
+	}
+
+	GU_DetailHandle packedDetailHandle;
+	packedDetailHandle.allocateAndSet(packedDetail.release());
+
+	std::lock_guard<std::mutex> guard(mStagingDetail ? mStagingMutex : mTargetDetailMutex);
+
+	const GU_PrimPacked* packedPrim = GU_PackedGeometry::packGeometry(*mDetail, packedDetailHandle);
+	mDetail->setPos3(packedPrim->getPointOffset(0), center);
+	setPackedPrimitiveData(packedPrim->getMapOffset(), isIndex, name, reports, shapeAttributes);
+}
+
+std::unique_ptr<GU_Detail>
+ModelConverter::createPackedDetail(const std::function<void(ModelConverter&)>& addMeshes) const {
+	// the groups are created around the packed primitive instead
+	auto packedDetail = std::make_unique<GU_Detail>();
+	std::mutex packedDetailMutex;
+	std::vector<prt::Status> packedStatuses(1, prt::STATUS_OK);
+	PrimitiveCreation packedPrimitiveCreation;
+	packedPrimitiveCreation.bridgeHoles = mPrimitiveCreation.bridgeHoles;
+	packedPrimitiveCreation.materialTable = mPrimitiveCreation.materialTable;
+
+	ModelConverter packedConverter(packedDetail.get(), packedDetailMutex, GroupCreation::NONE, packedStatuses,
+	                               nullptr, nullptr, nullptr, packedPrimitiveCreation);
+	addMeshes(packedConverter);
+	packedConverter.buildHoles();
+	return packedDetail;
+}
+
+void ModelConverter::setPackedPrimitiveData(GA_Offset primOffset, size_t isIndex, const wchar_t* name,
+                                            const prt::AttributeMap* reports,
+                                            const prt::AttributeMap* shapeAttributes) {
+	if (mShapeHashes != nullptr) {
+		GA_RWHandleT<int64> hashHandle(mDetail->addIntTuple(GA_ATTRIB_PRIMITIVE, GA_SCOPE_PRIVATE, PLD_SHAPE_HASH, 1,
+		                                                    GA_Defaults(0), nullptr, nullptr, GA_STORE_INT64));
+		hashHandle.set(primOffset, static_cast<int64>((*mShapeHashes)[isIndex]));
+	}
+
+	if (mGroupCreation == GroupCreation::PRIMCLS)
+		addToPrimitiveGroup(mDetail, name, GA_Range(mDetail->getPrimitiveMap(), primOffset, primOffset + 1));
+
+	if (reports != nullptr)
+		mToHoudini.convert(reports, primOffset, 1);
+	if (shapeAttributes != nullptr)
+		mToHoudini.convert(shapeAttributes, primOffset, 1, AttributeConversion::ToHoudini::ArrayHandling::ARRAY);
+}
+
+AttributeMapVector ModelConverter::getShapeAttributes(const int32_t* shapeIDs, size_t shapeIDsSize) const {
+	AttributeMapVector shapeAttributes;
+	if (mShapeAttributeBuilders.empty() || shapeIDsSize == 0)
+		return shapeAttributes;
+
+	shapeAttributes.resize(shapeIDsSize);
+	for (size_t si = 0; si < shapeIDsSize; si++) {
+		const auto it = mShapeAttributeBuilders.find(shapeIDs[si]);
+		if (it != mShapeAttributeBuilders.end())
+			shapeAttributes[si].reset(it->second->createAttributeMap());
+	}
+	return shapeAttributes;
+}
 
-	const GA_Offset primStartOffset = createPrimitives(
-	        mDetail, mHoleGroups, mGroupCreation, name, vtx, vtxSize, nrm, nrmSize, counts, countsSize, holeCounts,
-	        holeCountsSize, holeIndices, holeIndicesSize, vertexIndices, vertexIndicesSize, normalIndices,
-	        normalIndicesSize, uvs, uvsSizes, uvCounts, uvCountsSizes, uvIndices, uvIndicesSizes, uvSets);
+void ModelConverter::createDeferredPrimitives() {
+	if (mDeferredMeshes.empty())
+		return;
+
+	WA("all");
+
+	if (mPrimitiveCreation.bridgeHoles) {
+		for (DeferredMesh& dm : mDeferredMeshes) {
+			if (!hasHoles(dm.mesh->holeCounts.data(), dm.mesh->holeCounts.size()))
+				continue;
+			// the mesh might be shared with the generated model, which keeps its holes
+			auto bridged = std::make_shared<GeneratedMesh>(*dm.mesh);
+			if (bridgeHoles(*bridged)) // keeps the holes for buildHoles if bridging is not possible
+				dm.mesh = std::move(bridged);
+		}
+	}
+
+	// phase two: count the points, vertices and primitives of all collected meshes...
+	size_t numPoints = 0;
+	size_t numVertices = 0;
+	size_t numPrimitives = 0;
+	for (const DeferredMesh& dm : mDeferredMeshes) {
+		numPoints += dm.mesh->vtx.size() / 3;
+		numVertices += dm.mesh->vertexIndices.size();
+		numPrimitives += dm.mesh->counts.size();
+	}
+
+	// ... and build them all at once, i.e. the detail tables are allocated only once
+	UTVector3FVector utPoints;
+	utPoints.reserve(numPoints);
+	std::vector<int> vertexIndices;
+	vertexIndices.reserve(numVertices);
+	GEO_PolyCounts geoPolyCounts;
+	for (const DeferredMesh& dm : mDeferredMeshes) {
+		const auto pointBase = static_cast<int>(utPoints.size());
+		appendVertices(utPoints, dm.mesh->vtx.data(), dm.mesh->vtx.size());
+		for (const uint32_t c : dm.mesh->counts)
+			geoPolyCounts.append(c);
+		for (const uint32_t vi : dm.mesh->vertexIndices)
+			vertexIndices.push_back(pointBase + static_cast<int>(vi));
+	}
+
+	GA_Offset primStartOffset = GA_INVALID_OFFSET;
+	if (numPrimitives > 0) {
+		std::lock_guard<std::mutex> guard(mStagingDetail ? mStagingMutex : mTargetDetailMutex);
+		primStartOffset = GU_PrimPoly::buildBlock(mDetail, utPoints.data(), utPoints.size(), geoPolyCounts,
+		                                          vertexIndices.data());
+	}
+
+	for (const DeferredMesh& dm : mDeferredMeshes) {
+		addMesh(dm.isIndex, dm.name.c_str(), *dm.mesh, primStartOffset);
+		primStartOffset += static_cast<GA_Offset>(dm.mesh->counts.size());
+	}
+	mDeferredMeshes.clear();
+}
+
+void ModelConverter::addMesh(size_t isIndex, const wchar_t* name, const GeneratedMesh& mesh,
+                             GA_Offset primStartOffset) {
+	const auto uvSets = static_cast<uint32_t>(mesh.uvs.size());
+	const ArrayPtrs<double> uvs(mesh.uvs);
+	const ArrayPtrs<uint32_t> uvCounts(mesh.uvCounts);
+	const ArrayPtrs<uint32_t> uvIndices(mesh.uvIndices);
+
+	const AttributeMapNOPtrVector materials = toPtrVec(mesh.materials);
+	const AttributeMapNOPtrVector reports = toPtrVec(mesh.reports);
+	const AttributeMapNOPtrVector shapeAttributes = toPtrVec(mesh.shapeAttributes);
+
+	addMesh(isIndex, name, mesh.vtx.data(), mesh.vtx.size(), mesh.nrm.data(), mesh.nrm.size(), mesh.counts.data(),
+	        mesh.counts.size(), mesh.holeCounts.data(), mesh.holeCounts.size(), mesh.holeIndices.data(),
+	        mesh.holeIndices.size(), mesh.vertexIndices.data(), mesh.vertexIndices.size(), mesh.normalIndices.data(),
+	        mesh.normalIndices.size(), uvs.ptrs.data(), uvs.sizes.data(), uvCounts.ptrs.data(), uvCounts.sizes.data(),
+	        uvIndices.ptrs.data(), uvIndices.sizes.data(), uvSets, mesh.faceRanges.data(), mesh.faceRanges.size(),
+	        materials.empty() ? nullptr : materials.data(), reports.empty() ? nullptr : reports.data(),
+	        shapeAttributes.empty() ? nullptr : shapeAttributes.data(), primStartOffset);
+}
+
+void ModelConverter::addMesh(size_t isIndex, const wchar_t* name, const double* vtx, size_t vtxSize,
+                             const double* nrm, size_t nrmSize, const uint32_t* counts, size_t countsSize,
+                             const uint32_t* holeCounts, size_t holeCountsSize, const uint32_t* holeIndices,
+                             size_t holeIndicesSize, const uint32_t* vertexIndices, size_t vertexIndicesSize,
+                             const uint32_t* normalIndices, size_t normalIndicesSize, double const* const* uvs,
+                             size_t const* uvsSizes, uint32_t const* const* uvCounts, size_t const* uvCountsSizes,
+                             uint32_t const* const* uvIndices, size_t const* uvIndicesSizes, uint32_t uvSets,
+                             const uint32_t* faceRanges, size_t faceRangesSize,
+                             const prt::AttributeMap* const* materials, const prt::AttributeMap* const* reports,
+                             const prt::AttributeMap* const* shapeAttributes, GA_Offset primStartOffset) {
+	// merge the holes into their faces right away, the primitives are not yet built
+	if (mPrimitiveCreation.bridgeHoles && primStartOffset == GA_INVALID_OFFSET &&
+	    hasHoles(holeCounts, holeCountsSize)) {
+		HoleBridging::BridgedFaces bf;
+		if (HoleBridging::bridgeHoles(bf, vtx, vtxSize, counts, countsSize, holeCounts, holeCountsSize, holeIndices,
+		                              holeIndicesSize, vertexIndices, vertexIndicesSize, normalIndices,
+		                              normalIndicesSize, uvCounts, uvCountsSizes, uvIndices, uvIndicesSizes, uvSets,
+		                              faceRanges, faceRangesSize)) {
+			const ArrayPtrs<uint32_t> bfUVCounts(bf.uvCounts);
+			const ArrayPtrs<uint32_t> bfUVIndices(bf.uvIndices);
+			addMesh(isIndex, name, vtx, vtxSize, nrm, nrmSize, bf.counts.data(), bf.counts.size(), nullptr, 0,
+			        nullptr, 0, bf.vertexIndices.data(), bf.vertexIndices.size(), bf.normalIndices.data(),
+			        bf.normalIndices.size(), uvs, uvsSizes, bfUVCounts.ptrs.data(), bfUVCounts.sizes.data(),
+			        bfUVIndices.ptrs.data(), bfUVIndices.sizes.data(), uvSets, bf.faceRanges.data(),
+			        bf.faceRanges.size(), materials, reports, shapeAttributes, primStartOffset);
+			return;
+		}
+	}
+
+	// we need to protect mDetail, it is accessed by multiple generate threads
+	// (only the workers of our own generate call if we write to the staging detail)
+	std::lock_guard<std::mutex> guard(mStagingDetail ? mStagingMutex : mTargetDetailMutex);
+
+	if (primStartOffset == GA_INVALID_OFFSET)
+		primStartOffset = buildPrimitives(mDetail, vtx, vtxSize, counts, countsSize, vertexIndices);
+	setPrimitiveData(mDetail, primStartOffset, mHoleGroups, mGroupCreation, name, nrm, nrmSize, counts, countsSize,
+	                 holeCounts, holeCountsSize, holeIndices, holeIndicesSize, vertexIndicesSize, normalIndices,
+	                 normalIndicesSize, uvs, uvsSizes, uvCounts, uvCountsSizes, uvIndices, uvIndicesSizes, uvSets);
+
+	// -- tag the primitives with their initial shape, this allows to replace them individually on the next cook
+	if (mShapeHashes != nullptr) {
+		GA_RWHandleT<int64> hashHandle(mDetail->addIntTuple(GA_ATTRIB_PRIMITIVE, GA_SCOPE_PRIVATE, PLD_SHAPE_HASH, 1,
+		                                                    GA_Defaults(0), nullptr, nullptr, GA_STORE_INT64));
+		const auto hash = static_cast<int64>((*mShapeHashes)[isIndex]);
+		for (size_t pi = 0; pi < countsSize; pi++)
+			hashHandle.set(primStartOffset + pi, hash);
+	}
 
 	// -- convert materials/reports into primitive attributes based on face ranges
 	if (DBG)
@@ -205,28 +717,30 @@ void ModelConverter::add(const wchar_t* name, const double* vtx, size_t vtxSize,
 	if (faceRangesSize > 1) {
 		WA("add materials/reports");
 
-		AttributeConversion::ToHoudini toHoudini(mDetail);
+		GA_RWHandleI materialIndexHandle;
+		if (materials != nullptr && mPrimitiveCreation.materialTable != nullptr)
+			materialIndexHandle.bind(mDetail->addIntTuple(GA_ATTRIB_PRIMITIVE, PLD_MATERIAL_INDEX, 1, GA_Defaults(-1)));
+
 		for (size_t fri = 0; fri < faceRangesSize - 1; fri++) {
 			const GA_Offset rangeStart = primStartOffset + faceRanges[fri];
 			const GA_Size rangeSize = faceRanges[fri + 1] - faceRanges[fri];
 
 			if (materials != nullptr) {
-				toHoudini.convert(materials[fri], rangeStart, rangeSize);
+				if (materialIndexHandle.isValid()) {
+					const int32_t materialIndex = mPrimitiveCreation.materialTable->add(materials[fri]);
+					materialIndexHandle.setBlock(rangeStart, rangeSize, &materialIndex, 0); // stride 0: same value
+				}
+				else
+					mToHoudini.convert(materials[fri], rangeStart, rangeSize);
 			}
 
 			if (reports != nullptr) {
-				toHoudini.convert(reports[fri], rangeStart, rangeSize);
+				mToHoudini.convert(reports[fri], rangeStart, rangeSize);
 			}
 
-			if (!mShapeAttributeBuilders.empty()) {
-				// implicit contract: the attr{Bool,Float,String} callbacks are called prior to ModelConverter::add
-				const int32_t shapeID = shapeIDs[fri];
-				auto it = mShapeAttributeBuilders.find(shapeID);
-				if (it != mShapeAttributeBuilders.end()) {
-					const AttributeMapUPtr attrMap(it->second->createAttributeMap());
-					toHoudini.convert(attrMap.get(), rangeStart, rangeSize,
-					                  AttributeConversion::ToHoudini::ArrayHandling::ARRAY);
-				}
+			if (shapeAttributes != nullptr && shapeAttributes[fri] != nullptr) {
+				mToHoudini.convert(shapeAttributes[fri], rangeStart, rangeSize,
+				                   AttributeConversion::ToHoudini::ArrayHandling::ARRAY);
 			}
 		}
 	}
@@ -234,7 +748,7 @@ void ModelConverter::add(const wchar_t* name, const double* vtx, size_t vtxSize,
 
 prt::Status ModelConverter::generateError(size_t isIndex, prt::Status status, const wchar_t* message) {
 	LOG_WRN << message; // generate error for one shape is not yet a reason to abort cooking
-	mStatuses[isIndex] = status;
+	mStatuses[mInitialShapeIndexOffset + isIndex] = status;
 	return prt::STATUS_OK;
 }
 
@@ -251,7 +765,7 @@ prt::Status ModelConverter::cgaError(size_t isIndex, int32_t shapeID, prt::CGAEr
 }
 
 prt::Status ModelConverter::cgaPrint(size_t isIndex, int32_t shapeID, const wchar_t* txt) {
-	LOG_INF << isIndex << ": " << shapeID << ": " << txt;
+	LOG_INF << mInitialShapeIndexOffset + isIndex << ": " << shapeID << ": " << txt;
 	return prt::STATUS_OK;
 }
 
@@ -16,8 +16,13 @@
 
 #pragma once
 
+#include "AttributeConversion.h"
+#include "CancellationToken.h"
+#include "GeneratedModelCache.h"
+#include "MaterialTable.h"
 #include "PalladioMain.h"
 #include "ShapeConverter.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 #include "encoder/HoudiniCallbacks.h"
 
@@ -31,15 +36,19 @@
 
 #include "GEO/GEO_PolyCounts.h"
 #include "GU/GU_Detail.h"
+#include "GU/GU_DetailHandle.h"
 #include "GU/GU_PrimPoly.h"
-#include "UT/UT_Interrupt.h"
 #include "UT/UT_Vector3.h"
 
 #ifdef PLD_TC_GCC
 #	pragma GCC diagnostic pop
 #endif
 
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace ModelConversion {
@@ -54,6 +63,9 @@ void setUVs(GA_RWHandleV3& handle, const GA_Detail::OffsetMarker& marker, const
 
 } // namespace ModelConversion
 
+// private primitive attribute with the hash of the initial shape which generated the primitive (incremental mode)
+const UT_String PLD_SHAPE_HASH = "pldShapeHash";
+
 struct PrimitiveGroupDestroyer {
 	GA_ElementGroupTable& mGroupTable;
 	PrimitiveGroupDestroyer() = delete;
@@ -65,24 +77,84 @@ struct PrimitiveGroupDestroyer {
 using PrimitiveGroupUPtr = std::unique_ptr<GA_PrimitiveGroup, PrimitiveGroupDestroyer>;
 using PrimitiveGroups = std::vector<PrimitiveGroupUPtr>;
 
+struct PrimitiveCreation {
+	// create the primitives in a staging detail owned by the converter instead of gdp, i.e. concurrent converters
+	// do not wait for each other, see ModelConverter::mergeStagingDetails
+	bool stageGeometry = false;
+
+	// only collect the generated meshes and create the primitives of all of them at once,
+	// see ModelConverter::createDeferredPrimitives
+	bool deferPrimitives = false;
+
+	// merge holes into their faces while creating the primitives instead of running Houdini's buildHoles afterwards
+	bool bridgeHoles = false;
+
+	// wrap the primitives of each initial shape into one packed geometry primitive, takes precedence over
+	// deferPrimitives
+	bool packPrimitives = false;
+
+	// optional, if present the primitives only receive the index of their material in this table instead of the
+	// material attributes, shared by all converters writing into the same detail
+	MaterialTable* materialTable = nullptr;
+};
+
 class ModelConverter : public HoudiniCallbacks {
 public:
-	explicit ModelConverter(GU_Detail* gdp, GroupCreation gc, std::vector<prt::Status>& statuses,
-	                        UT_AutoInterrupt* autoInterrupt = nullptr);
+	using GeneratedModels = std::vector<std::shared_ptr<GeneratedModel>>;
+
+	/**
+	 * @param detailMutex guards gdp, shared by all converters writing into gdp
+	 * @param cancellation optional, once cancelled the generate calls are asked to finish and no more geometry is added
+	 * @param shapeHashes optional, if present the generated primitives are tagged with the hash of their initial shape
+	 * (indexed like statuses)
+	 * @param generatedModels optional, if present receives a copy of the generated model of each initial shape
+	 * (indexed like statuses)
+	 */
+	explicit ModelConverter(GU_Detail* gdp, std::mutex& detailMutex, GroupCreation gc,
+	                        std::vector<prt::Status>& statuses, const CancellationToken* cancellation = nullptr,
+	                        const std::vector<uint64_t>* shapeHashes = nullptr,
+	                        GeneratedModels* generatedModels = nullptr,
+	                        const PrimitiveCreation& primitiveCreation = PrimitiveCreation());
 	~ModelConverter() = default;
 
+	// converters with their own staging detail can build their holes concurrently
 	void buildHoles();
 
+	// creates the primitives of the collected meshes in one block, must be called after generate and before buildHoles
+	void createDeferredPrimitives();
+
+	// merges the staging details of the converters into their gdp (in parallel pairs), buildHoles must be called first
+	static void mergeStagingDetails(ThreadPool& threadPool, std::vector<std::unique_ptr<ModelConverter>>& converters);
+
+	// prepare for the next generate call on the chunk of initial shapes starting at isOffset,
+	// the callbacks receive indices relative to the chunk
+	void beginChunk(size_t isOffset);
+
+	// adds a model from the generated model cache, as if the initial shape had been generated
+	void add(size_t isIndex, const wchar_t* name, const GeneratedModel& model);
+
 protected:
-	void add(const wchar_t* name, const double* vtx, size_t vtxSize, const double* nrm, size_t nrmSize,
-	         const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
-	         const uint32_t* holeIndices, size_t holeIndicesSize, const uint32_t* vertexIndices,
-	         size_t vertexIndicesSize, const uint32_t* normalIndices, size_t normalIndicesSize,
+	void add(size_t isIndex, const wchar_t* name, const double* vtx, size_t vtxSize, const double* nrm,
+	         size_t nrmSize, const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts,
+	         size_t holeCountsSize, const uint32_t* holeIndices, size_t holeIndicesSize,
+	         const uint32_t* vertexIndices, size_t vertexIndicesSize, const uint32_t* normalIndices,
+	         size_t normalIndicesSize,
 	         double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
 	         size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
 	         uint32_t uvSets, const uint32_t* faceRanges, size_t faceRangesSize, const prt::AttributeMap** materials,
 	         const prt::AttributeMap** reports, const int32_t* shapeIDs) override;
 
+	void addPrototype(uint64_t prototypeKey, const double* vtx, size_t vtxSize, const double* nrm, size_t nrmSize,
+	                  const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
+	                  const uint32_t* holeIndices, size_t holeIndicesSize, const uint32_t* vertexIndices,
+	                  size_t vertexIndicesSize, const uint32_t* normalIndices, size_t normalIndicesSize,
+	                  double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
+	                  size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
+	                  uint32_t uvSets, const uint32_t* faceRanges, size_t faceRangesSize,
+	                  const prt::AttributeMap** materials) override;
+	void addInstances(size_t isIndex, const wchar_t* name, uint64_t prototypeKey, const double* transformations,
+	                  size_t instancesSize, const prt::AttributeMap** reports, const int32_t* shapeIDs) override;
+
 	prt::Status generateError(size_t isIndex, prt::Status status, const wchar_t* message) override;
 	prt::Status assetError(size_t isIndex, prt::CGAErrorLevel level, const wchar_t* key, const wchar_t* uri,
 	                       const wchar_t* message) override;
@@ -119,17 +191,67 @@ protected:
 #endif
 
 	prt::Callbacks::Continuation progress(float percentageCompleted) override {
-		if (mAutoInterrupt && mAutoInterrupt->wasInterrupted()) // TODO: is this thread-safe?
+		if (isCancelled())
 			return prt::Callbacks::CANCEL_AND_FINISH;
 		return prt::Callbacks::progress(percentageCompleted);
 	}
 
 private:
-	GU_Detail* mDetail;
+	bool isCancelled() const {
+		return (mCancellation != nullptr) && mCancellation->isCancelled();
+	}
+
+	void addMesh(size_t isIndex, const wchar_t* name, const double* vtx, size_t vtxSize, const double* nrm,
+	             size_t nrmSize, const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts,
+	             size_t holeCountsSize, const uint32_t* holeIndices, size_t holeIndicesSize,
+	             const uint32_t* vertexIndices, size_t vertexIndicesSize, const uint32_t* normalIndices,
+	             size_t normalIndicesSize, double const* const* uvs, size_t const* uvsSizes,
+	             uint32_t const* const* uvCounts, size_t const* uvCountsSizes, uint32_t const* const* uvIndices,
+	             size_t const* uvIndicesSizes, uint32_t uvSets, const uint32_t* faceRanges, size_t faceRangesSize,
+	             const prt::AttributeMap* const* materials, const prt::AttributeMap* const* reports,
+	             const prt::AttributeMap* const* shapeAttributes, GA_Offset primStartOffset);
+
+	// primStartOffset: first of the already built primitives of the mesh or GA_INVALID_OFFSET to build them
+	void addMesh(size_t isIndex, const wchar_t* name, const GeneratedMesh& mesh, GA_Offset primStartOffset);
+
+	// addMeshes adds the meshes of the initial shape to the given converter, which writes into the packed detail,
+	// the reports and shape attributes (both optional) are set on the packed primitive
+	void addPacked(size_t isIndex, const wchar_t* name, const std::function<void(ModelConverter&)>& addMeshes,
+	               const prt::AttributeMap* reports, const prt::AttributeMap* shapeAttributes);
+
+	// a detail of its own with the meshes added by addMeshes, for packed primitives
+	std::unique_ptr<GU_Detail> createPackedDetail(const std::function<void(ModelConverter&)>& addMeshes) const;
+
+	// tags a packed primitive like the primitives of its initial shape, mDetail must be locked
+	void setPackedPrimitiveData(GA_Offset primOffset, size_t isIndex, const wchar_t* name,
+	                            const prt::AttributeMap* reports, const prt::AttributeMap* shapeAttributes);
+
+	// the shape attributes of the given shape IDs (or none), see attrBool etc.
+	AttributeMapVector getShapeAttributes(const int32_t* shapeIDs, size_t shapeIDsSize) const;
+
+	struct DeferredMesh {
+		size_t isIndex;
+		std::wstring name;
+		GeneratedMeshSPtr mesh; // shared with the generated model (if any)
+	};
+
+	GU_Detail* mTargetDetail;
+	std::mutex& mTargetDetailMutex;
+	std::unique_ptr<GU_Detail> mStagingDetail; // optional, must outlive the hole groups
+	std::mutex mStagingMutex;                  // guards the staging detail and the deferred meshes
+	GU_Detail* mDetail;                        // receives the primitives, either the target or the staging detail
+	AttributeConversion::ToHoudini mToHoudini; // keeps the attribute schemas of mDetail across initial shapes
 	PrimitiveGroups mHoleGroups;
 	GroupCreation mGroupCreation;
 	std::vector<prt::Status>& mStatuses;
-	UT_AutoInterrupt* mAutoInterrupt;
+	const CancellationToken* mCancellation;
+	const std::vector<uint64_t>* mShapeHashes;
+	GeneratedModels* mGeneratedModels;
+	const PrimitiveCreation mPrimitiveCreation;
+	std::vector<DeferredMesh> mDeferredMeshes;
+	std::unordered_map<uint64_t, GU_DetailHandle> mPrototypes; // instancing, shared by the packed instances
+	std::mutex mPrototypesMutex;
+	size_t mInitialShapeIndexOffset = 0;
 	std::map<int32_t, AttributeMapBuilderUPtr> mShapeAttributeBuilders;
 };
 
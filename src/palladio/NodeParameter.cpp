@@ -25,6 +25,7 @@
 
 #include "CH/CH_Manager.h"
 
+#include <algorithm>
 #include <limits>
 #include <random>
 #include <string>
@@ -337,4 +338,82 @@ GroupCreation getGroupCreation(const OP_Node* node, fpreal t) {
 	}
 };
 
+bool getBridgeHoles(const OP_Node* node, fpreal t) {
+	return (node->evalInt(BRIDGE_HOLES.getToken(), 0, t) > 0);
+}
+
+size_t getChunkSize(const OP_Node* node, fpreal t) {
+	const auto chunkSize = node->evalInt(CHUNK_SIZE.getToken(), 0, t);
+	return static_cast<size_t>(std::max<exint>(chunkSize, 0));
+}
+
+size_t getGenerateBatches(const OP_Node* node, fpreal t) {
+	const auto batches = node->evalInt(GENERATE_BATCHES.getToken(), 0, t);
+	return static_cast<size_t>(std::max<exint>(batches, 0));
+}
+
+BatchBalancing getBatchBalancing(const OP_Node* node, fpreal t) {
+	const auto ord = node->evalInt(BATCH_BALANCING.getToken(), 0, t);
+	switch (ord) {
+		case 0:
+			return BatchBalancing::COUNT;
+		case 1:
+			return BatchBalancing::COST;
+		default:
+			return BatchBalancing::COUNT;
+	}
+}
+
+bool getOrderByLocality(const OP_Node* node, fpreal t) {
+	return (node->evalInt(ORDER_BY_LOCALITY.getToken(), 0, t) > 0);
+}
+
+OcclusionMode getOcclusionMode(const OP_Node* node, fpreal t) {
+	const auto ord = node->evalInt(OCCLUSION_MODE.getToken(), 0, t);
+	switch (ord) {
+		case 0:
+			return OcclusionMode::AUTOMATIC;
+		case 1:
+			return OcclusionMode::GLOBAL;
+		case 2:
+			return OcclusionMode::CHUNK;
+		case 3:
+			return OcclusionMode::OFF;
+		case 4:
+			return OcclusionMode::RADIUS;
+		default:
+			return OcclusionMode::GLOBAL;
+	}
+}
+
+double getOcclusionRadius(const OP_Node* node, fpreal t) {
+	return std::max<double>(node->evalFloat(OCCLUSION_RADIUS.getToken(), 0, t), 0.0);
+}
+
+bool getDeferPrimitives(const OP_Node* node, fpreal t) {
+	return (node->evalInt(DEFER_PRIMITIVES.getToken(), 0, t) > 0);
+}
+
+bool getPackPrimitives(const OP_Node* node, fpreal t) {
+	return (node->evalInt(PACK_PRIMITIVES.getToken(), 0, t) > 0);
+}
+
+bool getMaterialTable(const OP_Node* node, fpreal t) {
+	return (node->evalInt(MATERIAL_TABLE.getToken(), 0, t) > 0);
+}
+
+bool getIncremental(const OP_Node* node, fpreal t) {
+	return (node->evalInt(INCREMENTAL.getToken(), 0, t) > 0);
+}
+
+bool getUseModelCache(const OP_Node* node, fpreal t) {
+	return (node->evalInt(USE_MODEL_CACHE.getToken(), 0, t) > 0);
+}
+
+std::filesystem::path getModelCacheDirectory(const OP_Node* node, fpreal t) {
+	UT_String s;
+	node->evalString(s, MODEL_CACHE_DIR.getToken(), 0, t);
+	return s.toStdString();
+}
+
 } // namespace GenerateNodeParams
\ No newline at end of file
@@ -157,12 +157,221 @@ static PRM_Name EMIT_ATTRS("emitAttrs", "Re-emit set CGA attributes");
 static PRM_Name EMIT_MATERIAL("emitMaterials", "Emit material attributes");
 static PRM_Name EMIT_REPORTS("emitReports", "Emit CGA reports");
 static PRM_Name TRIANGULATE_FACES_WITH_HOLES("triangulateFacesWithHoles", "Triangulate polygons with holes");
+
+static PRM_Name BRIDGE_HOLES("bridgeHoles", "Bridge Holes Directly");
+const std::string BRIDGE_HOLES_HELP =
+        "Only applies if polygons with holes are not triangulated. Connects the holes to their polygons while the "
+        "polygons are created, instead of grouping the holes and running Houdini's hole builder on the whole output "
+        "afterwards. Falls back to the hole builder for meshes with nested holes or holes which cannot be bridged "
+        "without crossing other holes.";
+
+bool getBridgeHoles(const OP_Node* node, fpreal t);
+
+static PRM_Name INSTANCING("instancing", "Instance Repeated Assets");
+const std::string INSTANCING_HELP =
+        "Geometry which is inserted more than once into an initial shape (e.g. windows, columns or roof tiles) is "
+        "converted only once and placed as packed primitives sharing this geometry. Strongly reduces memory and "
+        "conversion time for asset-heavy rules. Use an Unpack node to get the polygons. The generated model cache "
+        "is not used in this mode.";
+
+static PRM_Name MERGE_MESHES("mergeMeshes", "Merge Meshes by Material");
+const std::string MERGE_MESHES_HELP =
+        "Merges the meshes of a generated model which share the same material before they are converted, i.e. a "
+        "model is created from one polygon range per material instead of one per inserted asset or face. Strongly "
+        "reduces conversion time for rules which create many small meshes. The CGA reports and the shape IDs of a "
+        "merged range are taken from one of its meshes.";
+
+// -- CHUNK SIZE
+static PRM_Name CHUNK_SIZE("chunkSize", "Initial Shapes per Chunk");
+static PRM_Range CHUNK_SIZE_RANGE(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_UI, 256);
+const std::string CHUNK_SIZE_HELP =
+        "Number of initial shapes passed to each generate call. Idle threads take over chunks from busy threads, "
+        "smaller chunks balance better at the cost of more calls. Set to 0 to choose the size automatically.";
+
+size_t getChunkSize(const OP_Node* node, fpreal t);
+
+// -- GENERATE BATCHES
+static PRM_Name GENERATE_BATCHES("generateBatches", "Concurrent Generate Calls");
+static PRM_Range GENERATE_BATCHES_RANGE(PRM_RANGE_RESTRICTED, 0, PRM_RANGE_UI, 64);
+const std::string GENERATE_BATCHES_HELP =
+        "Number of concurrent generate calls. The remaining cores are used by each call for its own worker threads, "
+        "i.e. the total number of threads never exceeds the number of cores. Set to 0 to use the environment variable "
+        "CITYENGINE_GENERATE_BATCHES or, if unset, one call per core.";
+
+size_t getGenerateBatches(const OP_Node* node, fpreal t);
+
+// -- BATCH BALANCING
+enum class BatchBalancing { COUNT, COST };
+static PRM_Name BATCH_BALANCING("batchBalancing", "Balance Chunks by");
+static const char* BATCH_BALANCING_TOKENS[] = {"COUNT", "COST"};
+static const char* BATCH_BALANCING_LABELS[] = {"Number of initial shapes", "Estimated generate cost"};
+static PRM_Name BATCH_BALANCING_MENU_ITEMS[] = {PRM_Name(BATCH_BALANCING_TOKENS[0], BATCH_BALANCING_LABELS[0]),
+                                                PRM_Name(BATCH_BALANCING_TOKENS[1], BATCH_BALANCING_LABELS[1]),
+                                                PRM_Name(nullptr)};
+static PRM_ChoiceList batchBalancingMenu((PRM_ChoiceListType)(PRM_CHOICELIST_EXCLUSIVE | PRM_CHOICELIST_REPLACE),
+                                         BATCH_BALANCING_MENU_ITEMS);
+const size_t DEFAULT_BATCH_BALANCING_ORDINAL = 0;
+static PRM_Default DEFAULT_BATCH_BALANCING(0, BATCH_BALANCING_TOKENS[DEFAULT_BATCH_BALANCING_ORDINAL]);
+const std::string BATCH_BALANCING_HELP =
+        "Estimated generate cost: chunks hold initial shapes of similar total cost instead of the same number of "
+        "initial shapes. The cost is estimated from the polygon size of the initial shapes and the generate times "
+        "measured per rule package and start rule in earlier cooks.";
+
+BatchBalancing getBatchBalancing(const OP_Node* node, fpreal t);
+
+static PRM_Name ORDER_BY_LOCALITY("orderByLocality", "Order Initial Shapes by Locality");
+const std::string ORDER_BY_LOCALITY_HELP =
+        "Sorts the initial shapes by rule package, start rule and position before they are split into chunks, so "
+        "each generate call works on nearby initial shapes with the same rule and shares more of its assets. Changes "
+        "the order of the generated primitives. Always enabled for occlusion queries within a radius.";
+
+bool getOrderByLocality(const OP_Node* node, fpreal t);
+
+// -- OCCLUSION
+enum class OcclusionMode { AUTOMATIC, GLOBAL, CHUNK, OFF, RADIUS };
+static PRM_Name OCCLUSION_MODE("occlusionMode", "Occlusion Queries");
+static const char* OCCLUSION_MODE_TOKENS[] = {"AUTOMATIC", "GLOBAL", "CHUNK", "OFF", "RADIUS"};
+static const char* OCCLUSION_MODE_LABELS[] = {"Automatic", "All initial shapes", "Initial shapes of the same chunk",
+                                              "Off", "Initial shapes within radius"};
+static PRM_Name OCCLUSION_MODE_MENU_ITEMS[] = {PRM_Name(OCCLUSION_MODE_TOKENS[0], OCCLUSION_MODE_LABELS[0]),
+                                               PRM_Name(OCCLUSION_MODE_TOKENS[1], OCCLUSION_MODE_LABELS[1]),
+                                               PRM_Name(OCCLUSION_MODE_TOKENS[2], OCCLUSION_MODE_LABELS[2]),
+                                               PRM_Name(OCCLUSION_MODE_TOKENS[3], OCCLUSION_MODE_LABELS[3]),
+                                               PRM_Name(OCCLUSION_MODE_TOKENS[4], OCCLUSION_MODE_LABELS[4]),
+                                               PRM_Name(nullptr)};
+static PRM_ChoiceList occlusionModeMenu((PRM_ChoiceListType)(PRM_CHOICELIST_EXCLUSIVE | PRM_CHOICELIST_REPLACE),
+                                        OCCLUSION_MODE_MENU_ITEMS);
+const size_t DEFAULT_OCCLUSION_MODE_ORDINAL = 1;
+static PRM_Default DEFAULT_OCCLUSION_MODE(0, OCCLUSION_MODE_TOKENS[DEFAULT_OCCLUSION_MODE_ORDINAL]);
+const std::string OCCLUSION_MODE_HELP =
+        "Which initial shapes are visible to the occlusion queries of the rules (inside, overlaps, touches and the "
+        "context queries). The occluders are generated in an extra pass before the actual generation. 'Automatic' "
+        "generates the occluders of all initial shapes, but skips the pass if the names of the occlusion queries do "
+        "not appear in the compiled rules. This search cannot prove that a rule does not query occlusion, use it only "
+        "for rule packages known to be free of occlusion queries. 'Initial shapes of the same chunk' generates the "
+        "occluders together with each chunk, i.e. initial shapes in other chunks are not seen. 'Off' always skips the "
+        "pass, occlusion queries then never find an occluder. 'Initial shapes within radius' generates the occluders "
+        "together with each chunk as well, including the initial shapes within the occlusion radius around the chunk. "
+        "An initial shape near several chunks is generated as occluder once per chunk, larger chunks reduce this "
+        "overhead.";
+
+OcclusionMode getOcclusionMode(const OP_Node* node, fpreal t);
+
+static PRM_Name OCCLUSION_RADIUS("occlusionRadius", "Occlusion Radius");
+static PRM_Default OCCLUSION_RADIUS_DEFAULT(100.0);
+static PRM_Range OCCLUSION_RADIUS_RANGE(PRM_RANGE_RESTRICTED, 0.0, PRM_RANGE_UI, 1000.0);
+const std::string OCCLUSION_RADIUS_HELP =
+        "Only used if the occlusion queries see the initial shapes within radius: the maximum distance between the "
+        "bounding boxes of two initial shapes which can occlude each other. Choose it larger than the largest "
+        "generated model extends beyond its initial shape.";
+
+double getOcclusionRadius(const OP_Node* node, fpreal t);
+
+// -- TWO-PHASE GEOMETRY
+static PRM_Name DEFER_PRIMITIVES("deferPrimitives", "Create Geometry in One Block per Batch");
+const std::string DEFER_PRIMITIVES_HELP =
+        "Collects the generated meshes of each batch first and then creates all their points, vertices and primitives "
+        "at once, instead of growing the geometry tables for every initial shape. Speeds up the creation of large "
+        "outputs, at the cost of keeping a copy of the generated meshes in memory until the batch is complete.";
+
+bool getDeferPrimitives(const OP_Node* node, fpreal t);
+
+// -- PACKED OUTPUT
+static PRM_Name PACK_PRIMITIVES("packPrimitives", "Pack Geometry per Initial Shape");
+const std::string PACK_PRIMITIVES_HELP =
+        "Wraps the generated geometry of each initial shape into one packed primitive, placed at the center of the "
+        "geometry and carrying the CGA reports and attributes of the first face range (shape) of the model, the "
+        "polygons inside keep the reports and attributes of their own face range. Viewport, copy and transform costs "
+        "then scale with the number of initial shapes instead of the number of polygons. Use an Unpack node to access "
+        "the polygons. Creating the geometry in one block per batch does not apply in this mode.";
+
+bool getPackPrimitives(const OP_Node* node, fpreal t);
+
+// -- MATERIAL TABLE
+static PRM_Name MATERIAL_TABLE("materialTable", "Store Materials in a Table");
+const std::string MATERIAL_TABLE_HELP =
+        "Only applies if material attributes are emitted. Stores each distinct material once as a dictionary in the "
+        "detail attribute 'materials' and only sets the primitive attribute 'materialIndex' (the index into "
+        "'materials') on the generated primitives, instead of copying all material attributes to every primitive. "
+        "Reduces memory use and conversion time of outputs with many primitives.";
+
+bool getMaterialTable(const OP_Node* node, fpreal t);
+
+// -- INCREMENTAL
+static PRM_Name INCREMENTAL("incremental", "Only Regenerate Changed Initial Shapes");
+const std::string INCREMENTAL_HELP =
+        "Keeps the generated geometry of initial shapes whose geometry, rule attributes, rule package (incl. its "
+        "modification time), start rule and random seed did not change since the last cook and only regenerates the "
+        "others. If any initial shape changed, the initial shapes whose rules might query occlusion are regenerated "
+        "as well (all initial shapes if the occlusion queries only see the initial shapes of the same chunk).";
+
+bool getIncremental(const OP_Node* node, fpreal t);
+
+// -- MODEL CACHE
+static PRM_Name USE_MODEL_CACHE("useModelCache", "Reuse Cached Models");
+const std::string USE_MODEL_CACHE_HELP =
+        "Stores the generated geometry of each initial shape in a cache shared by all generate nodes and reuses it "
+        "for identical initial shapes (geometry, rule attributes, rule package, start rule, random seed, encoder "
+        "options and occlusion mode) instead of generating them again. CGA print and error output is not repeated for "
+        "reused models. Initial shapes whose rules might query occlusion depend on their neighbours and are always "
+        "generated (unless occlusion queries are off). The memory budget is set with the environment variable "
+        "CITYENGINE_MODEL_CACHE_SIZE (in MB).";
+
+bool getUseModelCache(const OP_Node* node, fpreal t);
+
+static PRM_Name MODEL_CACHE_DIR("modelCacheDir", "Model Cache Directory");
+static PRM_Default MODEL_CACHE_DIR_DEFAULT(0, "");
+const std::string MODEL_CACHE_DIR_HELP =
+        "Additionally stores the cached models in this directory and reuses them across Houdini sessions and "
+        "processes, e.g. on a render farm. Several processes can safely share the same directory. The models are "
+        "only reused by machines with the same platform (operating system) which access the rule packages with "
+        "the same path and modification time. Leave empty to use the environment variable CITYENGINE_MODEL_CACHE_DIR "
+        "or, if unset, to only cache models in memory. Files are never deleted by palladio.";
+
+std::filesystem::path getModelCacheDirectory(const OP_Node* node, fpreal t);
+
 static PRM_Template PARAM_TEMPLATES[]{PRM_Template(PRM_ORD, PRM_Template::PRM_EXPORT_MAX, 1, &GROUP_CREATION,
                                                    &DEFAULT_GROUP_CREATION, &groupCreationMenu),
                                       PRM_Template(PRM_TOGGLE, 1, &EMIT_ATTRS),
                                       PRM_Template(PRM_TOGGLE, 1, &EMIT_MATERIAL),
                                       PRM_Template(PRM_TOGGLE, 1, &EMIT_REPORTS),
                                       PRM_Template(PRM_TOGGLE, 1, &TRIANGULATE_FACES_WITH_HOLES, PRMoneDefaults),
+                                      PRM_Template(PRM_TOGGLE, 1, &BRIDGE_HOLES, PRMzeroDefaults, nullptr, nullptr,
+                                                   PRM_Callback(), nullptr, 1, BRIDGE_HOLES_HELP.c_str()),
+                                      PRM_Template(PRM_TOGGLE, 1, &INSTANCING, PRMzeroDefaults, nullptr, nullptr,
+                                                   PRM_Callback(), nullptr, 1, INSTANCING_HELP.c_str()),
+                                      PRM_Template(PRM_TOGGLE, 1, &MERGE_MESHES, PRMzeroDefaults, nullptr, nullptr,
+                                                   PRM_Callback(), nullptr, 1, MERGE_MESHES_HELP.c_str()),
+                                      PRM_Template(PRM_INT, 1, &CHUNK_SIZE, PRMzeroDefaults, nullptr, &CHUNK_SIZE_RANGE,
+                                                   PRM_Callback(), nullptr, 1, CHUNK_SIZE_HELP.c_str()),
+                                      PRM_Template(PRM_INT, 1, &GENERATE_BATCHES, PRMzeroDefaults, nullptr,
+                                                   &GENERATE_BATCHES_RANGE, PRM_Callback(), nullptr, 1,
+                                                   GENERATE_BATCHES_HELP.c_str()),
+                                      PRM_Template(PRM_ORD, PRM_Template::PRM_EXPORT_MAX, 1, &BATCH_BALANCING,
+                                                   &DEFAULT_BATCH_BALANCING, &batchBalancingMenu, nullptr,
+                                                   PRM_Callback(), nullptr, 1, BATCH_BALANCING_HELP.c_str()),
+                                      PRM_Template(PRM_TOGGLE, 1, &ORDER_BY_LOCALITY, PRMzeroDefaults, nullptr,
+                                                   nullptr, PRM_Callback(), nullptr, 1,
+                                                   ORDER_BY_LOCALITY_HELP.c_str()),
+                                      PRM_Template(PRM_ORD, PRM_Template::PRM_EXPORT_MAX, 1, &OCCLUSION_MODE,
+                                                   &DEFAULT_OCCLUSION_MODE, &occlusionModeMenu, nullptr,
+                                                   PRM_Callback(), nullptr, 1, OCCLUSION_MODE_HELP.c_str()),
+                                      PRM_Template(PRM_FLT, 1, &OCCLUSION_RADIUS, &OCCLUSION_RADIUS_DEFAULT, nullptr,
+                                                   &OCCLUSION_RADIUS_RANGE, PRM_Callback(), nullptr, 1,
+                                                   OCCLUSION_RADIUS_HELP.c_str()),
+                                      PRM_Template(PRM_TOGGLE, 1, &DEFER_PRIMITIVES, PRMzeroDefaults, nullptr, nullptr,
+                                                   PRM_Callback(), nullptr, 1, DEFER_PRIMITIVES_HELP.c_str()),
+                                      PRM_Template(PRM_TOGGLE, 1, &PACK_PRIMITIVES, PRMzeroDefaults, nullptr, nullptr,
+                                                   PRM_Callback(), nullptr, 1, PACK_PRIMITIVES_HELP.c_str()),
+                                      PRM_Template(PRM_TOGGLE, 1, &MATERIAL_TABLE, PRMzeroDefaults, nullptr, nullptr,
+                                                   PRM_Callback(), nullptr, 1, MATERIAL_TABLE_HELP.c_str()),
+                                      PRM_Template(PRM_TOGGLE, 1, &INCREMENTAL, PRMzeroDefaults, nullptr, nullptr,
+                                                   PRM_Callback(), nullptr, 1, INCREMENTAL_HELP.c_str()),
+                                      PRM_Template(PRM_TOGGLE, 1, &USE_MODEL_CACHE, PRMzeroDefaults, nullptr, nullptr,
+                                                   PRM_Callback(), nullptr, 1, USE_MODEL_CACHE_HELP.c_str()),
+                                      PRM_Template(PRM_DIRECTORY, 1, &MODEL_CACHE_DIR, &MODEL_CACHE_DIR_DEFAULT,
+                                                   nullptr, nullptr, PRM_Callback(), nullptr, 1,
+                                                   MODEL_CACHE_DIR_HELP.c_str()),
                                       PRM_Template(PRM_ORD, PRM_Template::PRM_EXPORT_MAX, 1,
                                                    &CommonNodeParams::LOG_LEVEL, &CommonNodeParams::DEFAULT_LOG_LEVEL,
                                                    &CommonNodeParams::logLevelMenu),
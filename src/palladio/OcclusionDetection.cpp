@@ -0,0 +1,83 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OcclusionDetection.h"
+#include "LogHandler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::vector<std::string> OCCLUSION_FUNCTIONS = {"inside",         "overlaps",     "touches",
+                                                      "contextCompare", "contextCount", "minimumDistance"};
+
+// the compiled rules might store their names as UTF-16 (little endian)
+std::string toUTF16LE(const std::string& s) {
+	std::string r;
+	r.reserve(2 * s.size());
+	for (const char c : s) {
+		r.push_back(c);
+		r.push_back('\0');
+	}
+	return r;
+}
+
+bool contains(const char* data, size_t size, const std::string& pattern) {
+	return std::search(data, data + size, pattern.begin(), pattern.end()) != data + size;
+}
+
+} // namespace
+
+namespace OcclusionDetection {
+
+bool containsOcclusionQueries(const char* data, size_t size) {
+	return std::any_of(OCCLUSION_FUNCTIONS.begin(), OCCLUSION_FUNCTIONS.end(), [data, size](const std::string& f) {
+		return contains(data, size, f) || contains(data, size, toUTF16LE(f));
+	});
+}
+
+// any error while scanning counts as occlusion, i.e. the occlusion pass is never skipped by mistake
+bool usesOcclusionQueries(const std::filesystem::path& ruleDirectory) {
+	std::error_code ec;
+	size_t numRules = 0;
+	for (std::filesystem::recursive_directory_iterator it(ruleDirectory, ec), end; it != end; it.increment(ec)) {
+		const std::filesystem::directory_entry& entry = *it;
+		const bool isFile = entry.is_regular_file(ec);
+		if (ec)
+			return true;
+		if (!isFile || entry.path().extension() != ".cgb")
+			continue;
+		numRules++;
+
+		std::ifstream in(entry.path(), std::ios::binary);
+		if (!in)
+			return true;
+		const std::vector<char> data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+		if (containsOcclusionQueries(data.data(), data.size())) {
+			LOG_DBG << "rule " << entry.path() << " might query occlusion";
+			return true;
+		}
+	}
+
+	// do not skip the occlusion pass if we did not see any rule
+	return ec || (numRules == 0);
+}
+
+} // namespace OcclusionDetection
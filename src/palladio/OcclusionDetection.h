@@ -0,0 +1,37 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "PalladioMain.h"
+
+#include <cstddef>
+#include <filesystem>
+
+namespace OcclusionDetection {
+
+/**
+ * true if the compiled rule might call one of the CGA functions which depend on the occluders of other initial shapes
+ * (inside, overlaps, touches and the context queries). The names are searched in the raw bytes (ASCII and UTF-16LE),
+ * i.e. attributes or rules with similar names give false positives. A heuristic: a compiled format which stores the
+ * functions differently would be missed, therefore only used in the opt-in automatic occlusion mode.
+ */
+PLD_TEST_EXPORTS_API bool containsOcclusionQueries(const char* data, size_t size);
+
+// scans all compiled rules (*.cgb) below the directory, e.g. an unpacked rule package
+PLD_TEST_EXPORTS_API bool usesOcclusionQueries(const std::filesystem::path& ruleDirectory);
+
+} // namespace OcclusionDetection
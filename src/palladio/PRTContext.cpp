@@ -16,6 +16,7 @@
 
 #include "PRTContext.h"
 #include "LogHandler.h"
+#include "OcclusionDetection.h"
 #include "PalladioMain.h"
 
 #ifndef PLD_TEST_EXPORTS
@@ -31,7 +32,15 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <mutex>
+#include <string>
 #include <thread>
 
 #ifdef PLD_LINUX
@@ -100,6 +109,57 @@ uint32_t getNumCores() {
 	return n > 0 ? n : 1;
 }
 
+constexpr const char* PLD_GENERATE_BATCHES_ENV_VAR = "CITYENGINE_GENERATE_BATCHES";
+
+// must be called after the log handler is registered, invalid values fall back to automatic (0)
+uint32_t getGenerateBatches(uint32_t numCores) {
+	const char* e = std::getenv(PLD_GENERATE_BATCHES_ENV_VAR);
+	if (e == nullptr || std::strlen(e) == 0)
+		return 0;
+
+	char* end = nullptr;
+	errno = 0;
+	const unsigned long n = std::strtoul(e, &end, 10);
+	if (!std::isdigit(static_cast<unsigned char>(e[0])) || *end != '\0' || errno == ERANGE) {
+		LOG_WRN << PLD_GENERATE_BATCHES_ENV_VAR << " = " << e << " is not a valid number of batches, using automatic";
+		return 0;
+	}
+	if (n > numCores) {
+		LOG_WRN << PLD_GENERATE_BATCHES_ENV_VAR << " = " << e << " exceeds the number of cores, using " << numCores;
+		return numCores;
+	}
+	return static_cast<uint32_t>(n);
+}
+
+constexpr const char* PLD_MODEL_CACHE_SIZE_ENV_VAR = "CITYENGINE_MODEL_CACHE_SIZE";
+constexpr size_t DEFAULT_MODEL_CACHE_SIZE_MB = 1024;
+
+// must be called after the log handler is registered, invalid values fall back to the default size
+size_t getModelCacheBudget() {
+	constexpr size_t MB = 1024 * 1024;
+	const char* e = std::getenv(PLD_MODEL_CACHE_SIZE_ENV_VAR);
+	if (e == nullptr || std::strlen(e) == 0)
+		return DEFAULT_MODEL_CACHE_SIZE_MB * MB;
+
+	char* end = nullptr;
+	errno = 0;
+	const unsigned long long n = std::strtoull(e, &end, 10);
+	if (!std::isdigit(static_cast<unsigned char>(e[0])) || *end != '\0' || errno == ERANGE ||
+	    n > std::numeric_limits<size_t>::max() / MB) {
+		LOG_WRN << PLD_MODEL_CACHE_SIZE_ENV_VAR << " = " << e << " is not a valid size in MB, using "
+		        << DEFAULT_MODEL_CACHE_SIZE_MB;
+		return DEFAULT_MODEL_CACHE_SIZE_MB * MB;
+	}
+	return static_cast<size_t>(n) * MB;
+}
+
+constexpr const char* PLD_MODEL_CACHE_DIR_ENV_VAR = "CITYENGINE_MODEL_CACHE_DIR";
+
+std::filesystem::path getModelCacheDirectory() {
+	const char* e = std::getenv(PLD_MODEL_CACHE_DIR_ENV_VAR);
+	return (e != nullptr) ? std::filesystem::path(e) : std::filesystem::path();
+}
+
 /**
  * schedule recook of all assign nodes with matching rpk
  */
@@ -136,11 +196,15 @@ std::filesystem::path getProcessTempDir() {
 PRTContext::PRTContext(const std::vector<std::filesystem::path>& addExtDirs)
     : mLogHandler(new logging::LogHandler(PLD_LOG_PREFIX)), mPRTHandle{nullptr},
       mPRTCache{prt::CacheObject::create(prt::CacheObject::CACHE_TYPE_DEFAULT)}, mCores{getNumCores()},
-      mResolveMapCache{new ResolveMapCache(getProcessTempDir())} {
+      mThreadPool{new ThreadPool(mCores)}, mResolveMapCache{new ResolveMapCache(getProcessTempDir())},
+      mCostModel{new CostModel()}, mModelCacheDirectory{getModelCacheDirectory()} {
 	const prt::LogLevel defaultLogLevel = logging::getDefaultLogLevel();
 	prt::setLogLevel(defaultLogLevel);
 	prt::addLogHandler(mLogHandler.get());
 
+	mGenerateBatches = getGenerateBatches(mCores); // might warn about the environment variable
+	mGeneratedModelCache.reset(new GeneratedModelCache(getModelCacheBudget())); // might warn as well
+
 	// -- get the dir containing prt core library
 	const auto rootPath = []() {
 		std::filesystem::path prtCorePath;
@@ -187,6 +251,12 @@ PRTContext::PRTContext(const std::vector<std::filesystem::path>& addExtDirs)
 }
 
 PRTContext::~PRTContext() {
+	mThreadPool.reset(); // joins the workers, they must not outlive PRT
+	LOG_INF << "Stopped generate threads";
+
+	mGeneratedModelCache.reset(); // holds prt attribute maps
+	LOG_INF << "Released generated model cache";
+
 	mResolveMapCache.reset();
 	LOG_INF << "Released RPK Cache";
 
@@ -201,6 +271,7 @@ PRTContext::~PRTContext() {
 
 namespace {
 std::mutex mResolveMapCacheMutex;
+std::atomic<size_t> occlusionScanCounter{0}; // gives concurrent occlusion scans their own scratch directory
 }
 
 ResolveMapSPtr PRTContext::getResolveMap(const std::filesystem::path& rpk) {
@@ -215,3 +286,38 @@ ResolveMapSPtr PRTContext::getResolveMap(const std::filesystem::path& rpk) {
 	}
 	return lookupResult.first;
 }
+
+bool PRTContext::usesOcclusion(const std::filesystem::path& rpk) {
+	// embedded rule packages are not scanned
+	std::error_code ec;
+	const auto timeStamp = std::filesystem::last_write_time(rpk, ec);
+	if (ec || !std::filesystem::is_regular_file(rpk))
+		return true;
+
+	{
+		std::lock_guard<std::mutex> lock(mOcclusionUsageMutex);
+		const auto it = mOcclusionUsage.find(rpk);
+		if (it != mOcclusionUsage.end() && it->second.timeStamp == timeStamp)
+			return it->second.usesOcclusion;
+	}
+
+	// the resolve maps of the cache do not unpack the rules, unpack them once more into a scratch directory
+	// (without holding the lock, i.e. concurrent cooks might scan the same rpk, each in its own directory)
+	const std::filesystem::path unpackPath = getProcessTempDir() / "occlusion_scan" /
+	                                         (std::to_string(std::hash<std::string>()(rpk.string())) + "_" +
+	                                          std::to_string(occlusionScanCounter++));
+	bool usesOcclusion = true;
+	{
+		prt::Status status = prt::STATUS_UNSPECIFIED_ERROR;
+		const ResolveMapUPtr resolveMap(
+		        prt::createResolveMap(toFileURI(rpk).c_str(), unpackPath.wstring().c_str(), &status));
+		if (status == prt::STATUS_OK)
+			usesOcclusion = OcclusionDetection::usesOcclusionQueries(unpackPath);
+	}
+	std::filesystem::remove_all(unpackPath, ec);
+
+	LOG_INF << "rules of " << rpk << (usesOcclusion ? " might query occlusion" : " do not query occlusion");
+	std::lock_guard<std::mutex> lock(mOcclusionUsageMutex);
+	mOcclusionUsage[rpk] = {timeStamp, usesOcclusion};
+	return usesOcclusion;
+}
@@ -16,14 +16,18 @@
 
 #pragma once
 
+#include "CostModel.h"
+#include "GeneratedModelCache.h"
 #include "PalladioMain.h"
 #include "ResolveMapCache.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 
 #include "prt/Object.h"
 
 #include <filesystem>
 #include <map>
+#include <mutex>
 
 namespace logging {
 class LogHandler;
@@ -42,6 +46,10 @@ struct PLD_TEST_EXPORTS_API PRTContext final {
 	~PRTContext();
 
 	ResolveMapSPtr getResolveMap(const std::filesystem::path& rpk);
+
+	// true if the rules of the rpk might query occlusion, remembered per rpk until it is modified
+	bool usesOcclusion(const std::filesystem::path& rpk);
+
 	bool isAlive() const {
 		return mPRTHandle.operator bool();
 	}
@@ -50,7 +58,20 @@ struct PLD_TEST_EXPORTS_API PRTContext final {
 	ObjectUPtr mPRTHandle;
 	CacheObjectUPtr mPRTCache;
 	const uint32_t mCores;
+	uint32_t mGenerateBatches = 0; // default number of concurrent generate batches, 0 = automatic
+	ThreadPoolUPtr mThreadPool;    // shared by all nodes, limited to mCores threads
 	ResolveMapCacheUPtr mResolveMapCache;
+	CostModelUPtr mCostModel; // generate timings per rpk and start rule, used to balance generate batches
+	GeneratedModelCacheUPtr mGeneratedModelCache; // shared by all generate nodes
+	const std::filesystem::path mModelCacheDirectory; // default directory of the on-disk model cache, empty = disabled
+
+private:
+	struct OcclusionUsage {
+		std::filesystem::file_time_type timeStamp;
+		bool usesOcclusion;
+	};
+	std::map<std::filesystem::path, OcclusionUsage> mOcclusionUsage; // per rpk
+	std::mutex mOcclusionUsageMutex;
 };
 
 using PRTContextUPtr = std::unique_ptr<PRTContext>;
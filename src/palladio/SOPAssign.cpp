@@ -26,9 +26,12 @@
 #include "PrimitiveClassifier.h"
 #include "ShapeData.h"
 #include "ShapeGenerator.h"
+#include "ThreadPool.h"
 
 #include "prt/API.h"
 
+#include <algorithm>
+#include <future>
 #include <numeric>
 
 #include "CH/CH_Manager.h"
@@ -723,11 +726,36 @@ bool evaluateDefaultRuleAttributes(SOPAssign* node, const GU_Detail* detail, Sha
 	}
 	assert(shapeData.isValid());
 
-	// run generate to evaluate default rule attributes
-	AttrEvalCallbacks aec(shapeData.getRuleAttributeMapBuilders(), ruleFileInfos);
+	// run generate to evaluate default rule attributes, split into batches on the shared thread pool
 	const InitialShapeNOPtrVector& is = shapeData.getInitialShapes();
-	const prt::Status stat = prt::generate(is.data(), is.size(), nullptr, encs, encsCount, encsOpts, &aec,
-	                                       prtCtx->mPRTCache.get(), nullptr, nullptr, nullptr);
+	ThreadPool& threadPool = *prtCtx->mThreadPool;
+	const ThreadBudget threadBudget = getThreadBudget(prtCtx->mCores, is.size(), prtCtx->mGenerateBatches);
+	const size_t numBatches = threadBudget.batches;
+	const size_t batchSize = (is.size() + numBatches - 1) / numBatches;
+
+	AttributeMapBuilderUPtr genOptsBuilder(prt::AttributeMapBuilder::create());
+	genOptsBuilder->setInt(L"numberWorkerThreads", static_cast<int32_t>(threadBudget.workersPerBatch));
+	const AttributeMapUPtr genOpts(genOptsBuilder->createAttributeMap());
+
+	std::vector<std::future<prt::Status>> futures;
+	futures.reserve(numBatches);
+	for (size_t bi = 0; bi < numBatches; bi++) {
+		const size_t isStart = std::min(bi * batchSize, is.size());
+		const size_t isPastEnd = std::min(isStart + batchSize, is.size());
+		futures.emplace_back(threadPool.submit([&, isStart, isPastEnd]() {
+			AttrEvalCallbacks aec(shapeData.getRuleAttributeMapBuilders(), ruleFileInfos, isStart);
+			return prt::generate(is.data() + isStart, isPastEnd - isStart, nullptr, encs, encsCount, encsOpts, &aec,
+			                     prtCtx->mPRTCache.get(), nullptr, genOpts.get(), nullptr);
+		}));
+	}
+
+	prt::Status stat = prt::STATUS_OK;
+	for (auto& f : futures) {
+		const prt::Status batchStat = f.get();
+		if (batchStat != prt::STATUS_OK)
+			stat = batchStat;
+	}
+
 	if (stat != prt::STATUS_OK) {
 		errors.append("Failed to evaluate default attributes with status: '")
 		        .append(prt::getStatusDescription(stat))
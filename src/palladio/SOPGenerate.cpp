@@ -15,17 +15,32 @@
  */
 
 #include "SOPGenerate.h"
+#include "CancellationToken.h"
+#include "ChunkScheduler.h"
+#include "ContentHash.h"
+#include "GeneratedModelDiskCache.h"
+#include "MaterialTable.h"
 #include "ModelConverter.h"
 #include "MultiWatch.h"
 #include "NodeParameter.h"
 #include "PrimitiveClassifier.h"
 #include "ShapeData.h"
 #include "ShapeGenerator.h"
+#include "SpatialGrid.h"
 
 #include "UT/UT_Interrupt.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <functional>
 #include <future>
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_set>
 
 namespace {
 
@@ -50,10 +65,6 @@ SOPGenerate::SOPGenerate(const PRTContextUPtr& pCtx, OP_Network* net, const char
 	optionsBuilder->setString(L"name", FILE_CGA_PRINT);
 	const AttributeMapUPtr printOptions(optionsBuilder->createAttributeMapAndReset());
 	mCGAPrintOptions.reset(createValidatedOptions(ENCODER_ID_CGA_PRINT, printOptions.get()));
-
-	AttributeMapBuilderUPtr amb(prt::AttributeMapBuilder::create());
-	amb->setInt(L"numberWorkerThreads", mPRTCtx->mCores);
-	mGenerateOptions.reset(amb->createAttributeMapAndReset());
 }
 
 bool SOPGenerate::handleParams(OP_Context& context) {
@@ -63,12 +74,16 @@ bool SOPGenerate::handleParams(OP_Context& context) {
 	const bool emitReports = (evalInt(GenerateNodeParams::EMIT_REPORTS.getToken(), 0, now) > 0);
 	const bool triangulateFacesWithHoles =
 	        (evalInt(GenerateNodeParams::TRIANGULATE_FACES_WITH_HOLES.getToken(), 0, now) > 0);
+	const bool instancing = (evalInt(GenerateNodeParams::INSTANCING.getToken(), 0, now) > 0);
+	const bool mergeMeshes = (evalInt(GenerateNodeParams::MERGE_MESHES.getToken(), 0, now) > 0);
 
 	AttributeMapBuilderUPtr optionsBuilder(prt::AttributeMapBuilder::create());
 	optionsBuilder->setBool(EO_EMIT_ATTRIBUTES, emitAttributes);
 	optionsBuilder->setBool(EO_EMIT_MATERIALS, emitMaterial);
 	optionsBuilder->setBool(EO_EMIT_REPORTS, emitReports);
 	optionsBuilder->setBool(EO_TRIANGULATE_FACES_WITH_HOLES, triangulateFacesWithHoles);
+	optionsBuilder->setBool(EO_INSTANCING, instancing);
+	optionsBuilder->setBool(EO_MERGE_MESHES, mergeMeshes);
 	AttributeMapUPtr encoderOptions(optionsBuilder->createAttributeMapAndReset());
 	mHoudiniEncoderOptions.reset(createValidatedOptions(ENCODER_ID_HOUDINI, encoderOptions.get()));
 	if (!mHoudiniEncoderOptions)
@@ -82,58 +97,426 @@ bool SOPGenerate::handleParams(OP_Context& context) {
 
 namespace {
 
-enum class BatchMode { OCCLUSION, GENERATION };
-const std::vector<std::string> BATCH_MODE_NAMES = {"occlusion", "generation"};
+enum class BatchMode { OCCLUSION, GENERATION, GENERATION_WITH_CHUNK_OCCLUSION };
+const std::vector<std::string> BATCH_MODE_NAMES = {"occlusion", "generation", "generation with chunk occlusion"};
+
+struct ChunkTiming {
+	ChunkScheduler::Chunk chunk;
+	double seconds;
+};
+using ChunkTimings = std::vector<ChunkTiming>;
 
-std::vector<prt::Status> batchGenerate(BatchMode mode, size_t nThreads, std::vector<ModelConverterUPtr>& hg,
-                                       size_t isRangeSize, const InitialShapeNOPtrVector& is,
+// how often the cooking thread checks for a Houdini interrupt while the generate threads are busy
+constexpr std::chrono::milliseconds INTERRUPT_POLL_INTERVAL(10);
+
+// UT_AutoInterrupt must only be queried from the cooking thread, the generate threads only see the token
+bool pollInterrupt(UT_AutoInterrupt& progress, CancellationToken& cancellation) {
+	if (!cancellation.isCancelled() && progress.wasInterrupted())
+		cancellation.cancel();
+	return cancellation.isCancelled();
+}
+
+// the occluders of a chunk, see BatchMode::GENERATION_WITH_CHUNK_OCCLUSION
+struct ChunkOcclusion {
+	// one per batch, separate from the generation callbacks: their statuses are not used and their prints/errors are
+	// not reported (the generate call of the chunk reports them)
+	std::vector<ModelConverterUPtr>* callbacks;
+
+	// optional, initial shapes whose occluders are generated together with the occluders of a chunk,
+	// see OcclusionMode::RADIUS. Each chunk has its own occlusion set (the queries see all occluders of the set), i.e.
+	// a neighbour of k chunks is generated k times.
+	std::function<InitialShapeNOPtrVector(const ChunkScheduler::Chunk&)> getNeighbours;
+	std::atomic<size_t> numNeighbourOccluders{0};
+};
+
+std::vector<prt::Status> batchGenerate(ThreadPool& threadPool, BatchMode mode, size_t nThreads,
+                                       std::vector<ModelConverterUPtr>& hg, ChunkScheduler& scheduler,
+                                       const InitialShapeNOPtrVector& is,
                                        const std::vector<const wchar_t*>& allEncoders,
                                        const AttributeMapNOPtrVector& allEncoderOptions,
                                        std::vector<prt::OcclusionSet::Handle>& occlusionHandles,
                                        OcclusionSetUPtr& occlusionSet, CacheObjectUPtr& prtCache,
-                                       const AttributeMapUPtr& genOpts) {
-	std::vector<prt::Status> batchStatus(nThreads, prt::STATUS_UNSPECIFIED_ERROR);
+                                       const AttributeMapUPtr& genOpts, UT_AutoInterrupt& progress,
+                                       CancellationToken& cancellation, ChunkTimings* chunkTimings = nullptr,
+                                       ChunkOcclusion* chunkOcclusion = nullptr) {
+	std::vector<prt::Status> batchStatus(nThreads, prt::STATUS_OK);
+	std::vector<ChunkTimings> threadChunkTimings(nThreads);
 
 	std::vector<std::future<void>> futures;
 	futures.reserve(nThreads);
-	for (int8_t ti = 0; ti < nThreads; ti++) {
-		auto f = std::async(std::launch::async, [&, ti] { // capture thread index by value, else we have is range chaos
-			const size_t isStartPos = ti * isRangeSize;
-			const size_t isPastEndPos = (ti < nThreads - 1) ? (ti + 1) * isRangeSize : is.size();
-			const size_t isActualRangeSize = isPastEndPos - isStartPos;
-			const auto isRangeStart = &is[isStartPos];
-			const auto isOcclRangeStart = &occlusionHandles[isStartPos];
-
-			LOG_DBG << "thread " << ti << ": #is = " << isActualRangeSize;
-
-			switch (mode) {
-				case BatchMode::OCCLUSION: {
-					batchStatus[ti] = prt::generateOccluders(isRangeStart, isActualRangeSize, isOcclRangeStart, nullptr,
-					                                         0, nullptr, hg[ti].get(), prtCache.get(),
-					                                         occlusionSet.get(), genOpts.get());
-					break;
+	for (size_t ti = 0; ti < nThreads; ti++) {
+		auto f = threadPool.submit([&, ti] { // capture thread index by value, else we have is range chaos
+			auto processChunk = [&](const ChunkScheduler::Chunk& chunk) {
+				const auto chunkStart = std::chrono::steady_clock::now();
+
+				const auto isRangeStart = &is[chunk.begin];
+				const auto isOcclRangeStart = occlusionHandles.empty() ? nullptr : &occlusionHandles[chunk.begin];
+
+				hg[ti]->beginChunk(chunk.begin);
+
+				prt::Status status = prt::STATUS_UNSPECIFIED_ERROR;
+				switch (mode) {
+					case BatchMode::OCCLUSION: {
+						status = prt::generateOccluders(isRangeStart, chunk.size(), isOcclRangeStart, nullptr, 0,
+						                                nullptr, hg[ti].get(), prtCache.get(), occlusionSet.get(),
+						                                genOpts.get());
+						break;
+					}
+					case BatchMode::GENERATION: {
+						status = prt::generate(isRangeStart, chunk.size(), isOcclRangeStart, allEncoders.data(),
+						                       allEncoders.size(), allEncoderOptions.data(), hg[ti].get(),
+						                       prtCache.get(), occlusionSet.get(), genOpts.get());
+						break;
+					}
+					case BatchMode::GENERATION_WITH_CHUNK_OCCLUSION: {
+						// the occluders only live as long as the chunk, initial shapes of other chunks are not seen
+						// unless they are neighbours of the chunk
+						assert(chunkOcclusion != nullptr);
+						ModelConverter& occlusionCallbacks = *(*chunkOcclusion->callbacks)[ti];
+						occlusionCallbacks.beginChunk(chunk.begin);
+						OcclusionSetUPtr chunkOcclusionSet{prt::OcclusionSet::create()};
+						std::vector<prt::OcclusionSet::Handle> chunkOcclusionHandles(chunk.size());
+						status = prt::generateOccluders(isRangeStart, chunk.size(), chunkOcclusionHandles.data(),
+						                                nullptr, 0, nullptr, &occlusionCallbacks, prtCache.get(),
+						                                chunkOcclusionSet.get(), genOpts.get());
+
+						// a failed neighbour only means one occluder less
+						std::vector<prt::OcclusionSet::Handle> neighbourOcclusionHandles;
+						if (status == prt::STATUS_OK && chunkOcclusion->getNeighbours) {
+							const InitialShapeNOPtrVector neighbours = chunkOcclusion->getNeighbours(chunk);
+							neighbourOcclusionHandles.resize(neighbours.size());
+							chunkOcclusion->numNeighbourOccluders += neighbours.size();
+							if (!neighbours.empty()) {
+								occlusionCallbacks.beginChunk(0);
+								prt::generateOccluders(neighbours.data(), neighbours.size(),
+								                       neighbourOcclusionHandles.data(), nullptr, 0, nullptr,
+								                       &occlusionCallbacks, prtCache.get(), chunkOcclusionSet.get(),
+								                       genOpts.get());
+							}
+						}
+
+						if (status == prt::STATUS_OK)
+							status = prt::generate(isRangeStart, chunk.size(), chunkOcclusionHandles.data(),
+							                       allEncoders.data(), allEncoders.size(), allEncoderOptions.data(),
+							                       hg[ti].get(), prtCache.get(), chunkOcclusionSet.get(),
+							                       genOpts.get());
+						chunkOcclusionSet->dispose(chunkOcclusionHandles.data(), chunkOcclusionHandles.size());
+						chunkOcclusionSet->dispose(neighbourOcclusionHandles.data(), neighbourOcclusionHandles.size());
+						break;
+					}
 				}
-				case BatchMode::GENERATION: {
-					batchStatus[ti] = prt::generate(isRangeStart, isActualRangeSize, isOcclRangeStart,
-					                                allEncoders.data(), allEncoders.size(), allEncoderOptions.data(),
-					                                hg[ti].get(), prtCache.get(), occlusionSet.get(), genOpts.get());
-					break;
+
+				if (status != prt::STATUS_OK) {
+					LOG_WRN << "batch mode " << BATCH_MODE_NAMES[(int)mode] << " failed for initial shapes ["
+					        << chunk.begin << ", " << chunk.end << ") with status: '"
+					        << prt::getStatusDescription(status) << "' (" << status << ")";
+					batchStatus[ti] = status;
 				}
-			}
 
-			if (batchStatus[ti] != prt::STATUS_OK) {
-				LOG_WRN << "batch mode " << BATCH_MODE_NAMES[(int)mode] << " failed with status: '"
-				        << prt::getStatusDescription(batchStatus[ti]) << "' (" << batchStatus[ti] << ")";
-			}
+				if (chunkTimings != nullptr) {
+					const std::chrono::duration<double> chunkDuration = std::chrono::steady_clock::now() - chunkStart;
+					threadChunkTimings[ti].push_back({chunk, chunkDuration.count()});
+				}
+			};
+			const size_t numChunks = scheduler.run(ti, cancellation, processChunk);
 
+			LOG_DBG << "thread " << ti << ": processed " << numChunks << " chunks";
 		});
 		futures.emplace_back(std::move(f));
 	}
-	std::for_each(futures.begin(), futures.end(), [](std::future<void>& f) { f.wait(); });
+
+	// the batches stop after their current chunk once cancelled, the running generate calls via the callbacks
+	for (std::future<void>& f : futures) {
+		while (f.wait_for(INTERRUPT_POLL_INTERVAL) != std::future_status::ready)
+			pollInterrupt(progress, cancellation);
+	}
+	if (pollInterrupt(progress, cancellation))
+		LOG_INF << "batch mode " << BATCH_MODE_NAMES[(int)mode] << " cancelled";
+
+	LOG_DBG << "batch mode " << BATCH_MODE_NAMES[(int)mode] << ": #chunks = " << scheduler.getNumChunks()
+	        << ", #steals = " << scheduler.getNumSteals();
+
+	if (chunkTimings != nullptr) {
+		for (const ChunkTimings& ct : threadChunkTimings)
+			chunkTimings->insert(chunkTimings->end(), ct.begin(), ct.end());
+	}
 
 	return batchStatus;
 }
 
+using RuleKey = std::pair<std::filesystem::path, std::wstring>; // rpk and fully qualified start rule
+
+RuleKey getRuleKey(const ShapeData& shapeData, size_t isIdx) {
+	const InitialShapeInfo& info = shapeData.getInitialShapeInfo(isIdx);
+	return {info.rpk, info.startRule};
+}
+
+// true if any of the initial shapes to generate might query the occluders of its neighbours
+bool usesOcclusion(PRTContext& prtCtx, const ShapeData& shapeData, const std::vector<size_t>& generateIndices) {
+	std::set<std::filesystem::path> rpks;
+	for (const size_t isIdx : generateIndices)
+		rpks.insert(shapeData.getInitialShapeInfo(isIdx).rpk);
+	return std::any_of(rpks.begin(), rpks.end(),
+	                   [&prtCtx](const std::filesystem::path& rpk) { return prtCtx.usesOcclusion(rpk); });
+}
+
+// per initial shape: true if its rules might query occlusion, i.e. its model might depend on its neighbours
+std::vector<bool> getOcclusionDependency(PRTContext& prtCtx, const ShapeData& shapeData) {
+	std::map<std::filesystem::path, bool> rpkUsesOcclusion;
+	std::vector<bool> occlusionDependent(shapeData.getInitialShapes().size());
+	for (size_t isIdx = 0; isIdx < occlusionDependent.size(); isIdx++) {
+		const std::filesystem::path& rpk = shapeData.getInitialShapeInfo(isIdx).rpk;
+		auto it = rpkUsesOcclusion.find(rpk);
+		if (it == rpkUsesOcclusion.end())
+			it = rpkUsesOcclusion.emplace(rpk, prtCtx.usesOcclusion(rpk)).first;
+		occlusionDependent[isIdx] = it->second;
+	}
+	return occlusionDependent;
+}
+
+// initial shapes with the same key share the resolve map and the compiled rule file
+std::pair<const std::filesystem::path&, const std::wstring&> getRulePackageKey(const ShapeData& shapeData,
+                                                                               size_t isIdx) {
+	const InitialShapeInfo& info = shapeData.getInitialShapeInfo(isIdx);
+	return {info.rpk, info.ruleFile};
+}
+
+// keeps the initial shapes of each rule package and rule file together (in their original order), so each generate
+// call only needs one resolve map and compiled rule
+void groupByRulePackage(std::vector<size_t>& generateIndices, const ShapeData& shapeData) {
+	std::stable_sort(generateIndices.begin(), generateIndices.end(), [&shapeData](size_t a, size_t b) {
+		return getRulePackageKey(shapeData, a) < getRulePackageKey(shapeData, b);
+	});
+}
+
+// past-the-end generate index of each run of initial shapes with the same rule package and rule file,
+// see ChunkScheduler
+std::vector<size_t> getRulePackageEnds(const ShapeData& shapeData, const std::vector<size_t>& generateIndices) {
+	std::vector<size_t> ends;
+	for (size_t gi = 1; gi < generateIndices.size(); gi++) {
+		if (getRulePackageKey(shapeData, generateIndices[gi]) != getRulePackageKey(shapeData, generateIndices[gi - 1]))
+			ends.push_back(gi);
+	}
+	ends.push_back(generateIndices.size());
+	return ends;
+}
+
+// the chunks never span two rule packages (or rule files), i.e. the chunk timings add up per rule package
+void logRulePackageTimings(const ShapeData& shapeData, const std::vector<size_t>& generateIndices,
+                           const ChunkTimings& chunkTimings) {
+	struct RulePackageTiming {
+		size_t numChunks = 0;
+		size_t numShapes = 0;
+		double seconds = 0.0;
+	};
+
+	std::map<std::filesystem::path, RulePackageTiming> timings;
+	for (const ChunkTiming& ct : chunkTimings) {
+		if (ct.chunk.size() == 0)
+			continue;
+		RulePackageTiming& t = timings[shapeData.getInitialShapeInfo(generateIndices[ct.chunk.begin]).rpk];
+		t.numChunks++;
+		t.numShapes += ct.chunk.size();
+		t.seconds += ct.seconds;
+	}
+	for (const auto& t : timings) {
+		LOG_INF << "rule package " << t.first << ": #chunks = " << t.second.numChunks
+		        << ", #initial shapes = " << t.second.numShapes << ", generate time = " << t.second.seconds
+		        << "s (summed over all batches)";
+	}
+}
+
+std::vector<BoundingBox> getShapeBounds(const ShapeData& shapeData) {
+	const size_t numShapes = shapeData.getInitialShapes().size();
+	std::vector<BoundingBox> bounds(numShapes);
+	for (size_t isIdx = 0; isIdx < numShapes; isIdx++)
+		bounds[isIdx] = shapeData.getGeometryStats(shapeData.getInitialShapeInfo(isIdx).builderIndex).bounds;
+	return bounds;
+}
+
+// groups the initial shapes by rule package, rule file and start rule and orders each group along a space-filling
+// curve, i.e. consecutive initial shapes (and therefore the chunks) share their rule and most of their assets and
+// neighbours
+void orderByLocality(std::vector<size_t>& generateIndices, const ShapeData& shapeData,
+                     const std::vector<BoundingBox>& shapeBounds) {
+	BoundingBox extent;
+	for (const size_t isIdx : generateIndices) {
+		const BoundingBox& b = shapeBounds[isIdx];
+		if (!b.isEmpty()) {
+			extent.add(b.min[0], b.min[1], b.min[2]);
+			extent.add(b.max[0], b.max[1], b.max[2]);
+		}
+	}
+
+	std::vector<uint64_t> codes(shapeBounds.size(), 0);
+	for (const size_t isIdx : generateIndices)
+		codes[isIdx] = getMortonCode(shapeBounds[isIdx], extent);
+
+	std::stable_sort(generateIndices.begin(), generateIndices.end(), [&](size_t a, size_t b) {
+		const InitialShapeInfo& ia = shapeData.getInitialShapeInfo(a);
+		const InitialShapeInfo& ib = shapeData.getInitialShapeInfo(b);
+		if (getRulePackageKey(shapeData, a) != getRulePackageKey(shapeData, b))
+			return getRulePackageKey(shapeData, a) < getRulePackageKey(shapeData, b);
+		if (ia.startRule != ib.startRule)
+			return ia.startRule < ib.startRule;
+		return codes[a] < codes[b];
+	});
+}
+
+double getUnits(const ShapeData& shapeData, size_t isIdx) {
+	const InitialShapeGeometryStats& stats =
+	        shapeData.getGeometryStats(shapeData.getInitialShapeInfo(isIdx).builderIndex);
+	return CostModel::getUnits(stats.numFaces, stats.numVertices);
+}
+
+std::vector<double> estimateCosts(const ShapeData& shapeData, const CostModel& costModel) {
+	const size_t numShapes = shapeData.getInitialShapes().size();
+
+	std::map<RuleKey, double> secondsPerUnit; // look up each rule only once
+	std::vector<double> costs(numShapes);
+	for (size_t isIdx = 0; isIdx < numShapes; isIdx++) {
+		const RuleKey key = getRuleKey(shapeData, isIdx);
+		auto it = secondsPerUnit.find(key);
+		if (it == secondsPerUnit.end())
+			it = secondsPerUnit.emplace(key, costModel.getSecondsPerUnit(key.first, key.second)).first;
+		costs[isIdx] = it->second * getUnits(shapeData, isIdx);
+	}
+	return costs;
+}
+
+// distribute the measured duration of each chunk to the rules in the chunk, weighted by their estimated cost
+// (the chunks index into isIndices, i.e. the initial shapes passed to generate)
+void updateCostModel(CostModel& costModel, const ShapeData& shapeData, const std::vector<size_t>& isIndices,
+                     const std::vector<double>& costs, const ChunkTimings& chunkTimings) {
+	struct RuleMeasurement {
+		double units = 0.0;
+		double estimatedCost = 0.0;
+	};
+
+	for (const ChunkTiming& ct : chunkTimings) {
+		std::map<RuleKey, RuleMeasurement> ruleMeasurements;
+		double chunkCost = 0.0;
+		for (size_t gi = ct.chunk.begin; gi < ct.chunk.end; gi++) {
+			const size_t isIdx = isIndices[gi];
+			RuleMeasurement& rm = ruleMeasurements[getRuleKey(shapeData, isIdx)];
+			rm.units += getUnits(shapeData, isIdx);
+			rm.estimatedCost += costs[isIdx];
+			chunkCost += costs[isIdx];
+		}
+		if (chunkCost <= 0.0)
+			continue;
+
+		for (const auto& rm : ruleMeasurements) {
+			const double seconds = ct.seconds * rm.second.estimatedCost / chunkCost;
+			costModel.addMeasurement(rm.first.first, rm.first.second, rm.second.units, seconds);
+		}
+	}
+}
+
+// -- incremental mode
+
+// everything besides the initial shapes which has an influence on the generated primitives
+uint64_t getSettingsHash(const OP_Node* node, fpreal t, const prt::AttributeMap* encoderOptions,
+                         const std::wstring& nodeName) {
+	using GenerateNodeParams::OcclusionMode;
+	const OcclusionMode occlusionMode = GenerateNodeParams::getOcclusionMode(node, t);
+	const bool materialTable =
+	        GenerateNodeParams::getMaterialTable(node, t) && encoderOptions->getBool(EO_EMIT_MATERIALS);
+
+	ContentHash hash;
+	hash.add(encoderOptions).add(static_cast<int32_t>(GenerateNodeParams::getGroupCreation(node, t)));
+	hash.add(GenerateNodeParams::getBridgeHoles(node, t)).add(GenerateNodeParams::getPackPrimitives(node, t));
+	hash.add(materialTable).add(static_cast<int32_t>(occlusionMode));
+	if (occlusionMode == OcclusionMode::RADIUS)
+		hash.add(GenerateNodeParams::getOcclusionRadius(node, t));
+
+	// with occlusion per chunk the occluders depend on how the initial shapes are split into chunks
+	if (occlusionMode == OcclusionMode::CHUNK || occlusionMode == OcclusionMode::RADIUS) {
+		hash.add(GenerateNodeParams::getChunkSize(node, t)).add(GenerateNodeParams::getGenerateBatches(node, t));
+		hash.add(static_cast<int32_t>(GenerateNodeParams::getBatchBalancing(node, t)));
+		hash.add(GenerateNodeParams::getOrderByLocality(node, t));
+	}
+	hash.add(nodeName);
+	return hash.get();
+}
+
+std::unordered_map<uint64_t, size_t> countPrimitivesPerShape(const GU_Detail* detail) {
+	std::unordered_map<uint64_t, size_t> primCounts;
+	const GA_ROHandleT<int64> hashHandle(detail->findAttribute(GA_ATTRIB_PRIMITIVE, GA_SCOPE_PRIVATE, PLD_SHAPE_HASH));
+	if (hashHandle.isInvalid())
+		return primCounts;
+	for (GA_Iterator it(detail->getPrimitiveRange()); !it.atEnd(); ++it)
+		primCounts[static_cast<uint64_t>(hashHandle.get(*it))]++;
+	return primCounts;
+}
+
+// an initial shape is up to date if the detail still holds exactly the primitives it generated in the last cook
+std::unordered_set<uint64_t> getUpToDateShapes(const GU_Detail* detail, const std::vector<uint64_t>& shapeHashes,
+                                               const std::unordered_map<uint64_t, size_t>& generatedShapes) {
+	// identical initial shapes cannot be told apart on the detail, we always regenerate them
+	std::unordered_map<uint64_t, size_t> occurrences;
+	for (const uint64_t h : shapeHashes)
+		occurrences[h]++;
+
+	const std::unordered_map<uint64_t, size_t> primCounts = countPrimitivesPerShape(detail);
+
+	std::unordered_set<uint64_t> upToDate;
+	for (const uint64_t h : shapeHashes) {
+		if (occurrences[h] > 1)
+			continue;
+		const auto genIt = generatedShapes.find(h);
+		if (genIt == generatedShapes.end())
+			continue;
+		const auto primIt = primCounts.find(h);
+		const size_t primCount = (primIt != primCounts.end()) ? primIt->second : 0;
+		if (primCount == genIt->second)
+			upToDate.insert(h);
+	}
+	return upToDate;
+}
+
+// true if an initial shape was added, modified or removed since the last cook
+bool hasChangedShapes(const std::vector<uint64_t>& shapeHashes, const std::unordered_set<uint64_t>& upToDateShapes,
+                      const std::unordered_map<uint64_t, size_t>& generatedShapes) {
+	if (upToDateShapes.size() < shapeHashes.size())
+		return true;
+	const std::unordered_set<uint64_t> currentShapes(shapeHashes.begin(), shapeHashes.end());
+	return std::any_of(generatedShapes.begin(), generatedShapes.end(),
+	                   [&currentShapes](const auto& gs) { return currentShapes.count(gs.first) == 0; });
+}
+
+// the occlusion queries see the occluders of the other initial shapes, i.e. after a change the initial shapes which
+// might query occlusion are outdated, too (with occlusion per chunk all initial shapes, the chunks are different)
+void removeOcclusionDependentShapes(std::unordered_set<uint64_t>& upToDateShapes,
+                                    const std::vector<uint64_t>& shapeHashes,
+                                    const std::vector<bool>& occlusionDependent, bool chunkOcclusion) {
+	if (std::find(occlusionDependent.begin(), occlusionDependent.end(), true) == occlusionDependent.end())
+		return;
+	if (chunkOcclusion) {
+		upToDateShapes.clear();
+		return;
+	}
+	for (size_t isIdx = 0; isIdx < shapeHashes.size(); isIdx++) {
+		if (occlusionDependent[isIdx])
+			upToDateShapes.erase(shapeHashes[isIdx]);
+	}
+}
+
+void destroyOutdatedPrimitives(GU_Detail* detail, const std::unordered_set<uint64_t>& upToDateShapes) {
+	const GA_ROHandleT<int64> hashHandle(detail->findAttribute(GA_ATTRIB_PRIMITIVE, GA_SCOPE_PRIVATE, PLD_SHAPE_HASH));
+	if (hashHandle.isInvalid() || upToDateShapes.empty()) {
+		detail->clearAndDestroy();
+		return;
+	}
+
+	GA_PrimitiveGroupUPtr outdated = detail->createDetachedPrimitiveGroup();
+	for (GA_Iterator it(detail->getPrimitiveRange()); !it.atEnd(); ++it) {
+		if (upToDateShapes.count(static_cast<uint64_t>(hashHandle.get(*it))) == 0)
+			outdated->addOffset(*it);
+	}
+	detail->destroyPrimitives(GA_Range(*outdated), true);
+}
+
 } // namespace
 
 OP_ERROR SOPGenerate::cookMySop(OP_Context& context) {
@@ -147,18 +530,25 @@ OP_ERROR SOPGenerate::cookMySop(OP_Context& context) {
 	if (lockInputs(context) >= UT_ERROR_ABORT)
 		return error();
 
-	duplicateSource(0, context);
+	// in incremental mode our detail keeps the primitives of the last cook and we read the initial shapes directly
+	// from the (locked) input
+	const bool incremental = GenerateNodeParams::getIncremental(this, context.getTime());
+	if (!incremental)
+		duplicateSource(0, context);
+	const GU_Detail* inputDetail = incremental ? inputGeo(0, context) : gdp;
 
-	if (error() >= UT_ERROR_ABORT || cookInputGroups(context) >= UT_ERROR_ABORT)
+	if (error() >= UT_ERROR_ABORT || cookInputGroups(context) >= UT_ERROR_ABORT || inputDetail == nullptr)
 		return error();
 
 	UT_AutoInterrupt progress("Generating CityEngine geometry...");
+	CancellationToken cancellation;
 
 	const auto groupCreation = GenerateNodeParams::getGroupCreation(this, context.getTime());
-	ShapeData shapeData(groupCreation, toUTF16FromOSNarrow(getName().toStdString()));
+	const std::wstring nodeName = toUTF16FromOSNarrow(getName().toStdString());
+	ShapeData shapeData(groupCreation, nodeName);
 
 	ShapeGenerator shapeGen;
-	shapeGen.get(gdp, DEFAULT_PRIMITIVE_CLASSIFIER, shapeData, mPRTCtx);
+	shapeGen.get(inputDetail, DEFAULT_PRIMITIVE_CLASSIFIER, shapeData, mPRTCtx);
 
 	const InitialShapeNOPtrVector& is = shapeData.getInitialShapes();
 	if (is.empty()) {
@@ -166,45 +556,421 @@ OP_ERROR SOPGenerate::cookMySop(OP_Context& context) {
 		return UT_ERROR_ABORT;
 	}
 
-	// establish threads
-	const size_t nThreads = std::min<size_t>(mPRTCtx->mCores, is.size());
-	const size_t isRangeSize = std::ceil(is.size() / nThreads);
+	// select the initial shapes to generate: all of them, or in incremental mode the ones whose primitives from the
+	// last cook are outdated
+	// (the shape name decides about the primitive group of the generated primitives)
+	std::vector<uint64_t> shapeHashes(is.size());
+	for (size_t isIdx = 0; isIdx < is.size(); isIdx++) {
+		const InitialShapeInfo& info = shapeData.getInitialShapeInfo(isIdx);
+		shapeHashes[isIdx] = ContentHash().add(info.hash).add(shapeData.getInitialShapeName(info.builderIndex)).get();
+	}
+
+	const auto occlusionMode = GenerateNodeParams::getOcclusionMode(this, context.getTime());
+	const double occlusionRadius = GenerateNodeParams::getOcclusionRadius(this, context.getTime());
+	const bool packPrimitives = GenerateNodeParams::getPackPrimitives(this, context.getTime());
+	const bool useMaterialTable = GenerateNodeParams::getMaterialTable(this, context.getTime()) &&
+	                              mHoudiniEncoderOptions->getBool(EO_EMIT_MATERIALS);
+	const uint64_t settingsHash = getSettingsHash(this, context.getTime(), mHoudiniEncoderOptions.get(), nodeName);
+	const bool canReusePrimitives = incremental && (settingsHash == mGeneratedSettingsHash);
+	std::unordered_set<uint64_t> upToDateShapes = canReusePrimitives
+	                                                      ? getUpToDateShapes(gdp, shapeHashes, mGeneratedShapes)
+	                                                      : std::unordered_set<uint64_t>();
+
+	// the cached models only hold meshes, the instances of instancing mode would get lost
+	const bool useModelCache = GenerateNodeParams::getUseModelCache(this, context.getTime()) &&
+	                           !mHoudiniEncoderOptions->getBool(EO_INSTANCING);
+
+	// the models of initial shapes which might query occlusion depend on their neighbours (unless the queries never
+	// see an occluder): they are regenerated if any other initial shape changed and they are not cached
+	const std::vector<bool> occlusionDependent =
+	        ((useModelCache || !upToDateShapes.empty()) && occlusionMode != GenerateNodeParams::OcclusionMode::OFF)
+	                ? getOcclusionDependency(*mPRTCtx, shapeData)
+	                : std::vector<bool>(is.size(), false);
+	if (!upToDateShapes.empty() && hasChangedShapes(shapeHashes, upToDateShapes, mGeneratedShapes)) {
+		const size_t numUpToDate = upToDateShapes.size();
+		removeOcclusionDependentShapes(upToDateShapes, shapeHashes, occlusionDependent,
+		                               occlusionMode == GenerateNodeParams::OcclusionMode::CHUNK);
+		if (upToDateShapes.size() < numUpToDate)
+			LOG_INF << getName() << ": regenerating " << numUpToDate - upToDateShapes.size()
+			        << " unchanged initial shapes which might query the occluders of changed initial shapes";
+	}
+
+	// outdated initial shapes are taken from the generated model cache if possible, the others are generated
+	GeneratedModelCache& modelCache = *mPRTCtx->mGeneratedModelCache;
+	const uint64_t modelSettingsHash = [&]() {
+		ContentHash hash;
+		hash.add(mHoudiniEncoderOptions.get()).add(static_cast<int32_t>(occlusionMode));
+		if (occlusionMode == GenerateNodeParams::OcclusionMode::RADIUS)
+			hash.add(occlusionRadius);
+		return hash.get();
+	}();
+	auto getModelKey = [&shapeData, modelSettingsHash](size_t isIdx) {
+		return ContentHash().add(shapeData.getInitialShapeInfo(isIdx).hash).add(modelSettingsHash).get();
+	};
+	auto isCacheable = [useModelCache, &occlusionDependent](size_t isIdx) {
+		return useModelCache && !occlusionDependent[isIdx];
+	};
+
+	// models missing in memory are looked up in the optional cache directory, e.g. written by other farm processes
+	const std::filesystem::path modelCacheDir = [this, &context]() {
+		const std::filesystem::path d = GenerateNodeParams::getModelCacheDirectory(this, context.getTime());
+		return d.empty() ? mPRTCtx->mModelCacheDirectory : d;
+	}();
+	std::unique_ptr<GeneratedModelDiskCache> diskCache;
+	if (useModelCache && !modelCacheDir.empty())
+		diskCache = std::make_unique<GeneratedModelDiskCache>(modelCacheDir);
+
+	std::vector<GeneratedModelSPtr> models(is.size()); // cached model per initial shape, null if not cached
+	std::vector<size_t> memoryMisses;
+	for (size_t isIdx = 0; isIdx < is.size(); isIdx++) {
+		if (!isCacheable(isIdx) || upToDateShapes.count(shapeHashes[isIdx]) > 0)
+			continue;
+		models[isIdx] = modelCache.get(getModelKey(isIdx));
+		if (!models[isIdx])
+			memoryMisses.push_back(isIdx);
+	}
+	if (diskCache && !memoryMisses.empty()) {
+		WA("read cached models");
+		mPRTCtx->mThreadPool->parallelFor(memoryMisses.size(), [&](size_t mi) {
+			const size_t isIdx = memoryMisses[mi];
+			const uint64_t key = getModelKey(isIdx);
+			models[isIdx] = diskCache->get(key);
+			if (models[isIdx])
+				modelCache.insert(key, models[isIdx]);
+		});
+	}
+
+	std::vector<size_t> cachedIndices; // cached model index -> initial shape index
+	std::vector<GeneratedModelSPtr> cachedModels;
+	std::vector<size_t> generateIndices; // generate array index -> initial shape index
+	for (size_t isIdx = 0; isIdx < is.size(); isIdx++) {
+		if (upToDateShapes.count(shapeHashes[isIdx]) > 0)
+			continue;
+		if (models[isIdx]) {
+			cachedIndices.push_back(isIdx);
+			cachedModels.emplace_back(std::move(models[isIdx]));
+		}
+		else
+			generateIndices.push_back(isIdx);
+	}
+
+	// occlusion within a radius: index the bounds of all initial shapes and generate neighbouring initial shapes
+	// together, so the chunks are spatially compact and share most of their neighbours
+	// in any case, the initial shapes of each rule package are generated together
+	const bool useRadiusOcclusion = (occlusionMode == GenerateNodeParams::OcclusionMode::RADIUS);
+	std::unique_ptr<SpatialGrid> occlusionGrid;
+	std::vector<BoundingBox> shapeBounds;
+	if (useRadiusOcclusion || GenerateNodeParams::getOrderByLocality(this, context.getTime())) {
+		shapeBounds = getShapeBounds(shapeData);
+		orderByLocality(generateIndices, shapeData, shapeBounds);
+	}
+	else
+		groupByRulePackage(generateIndices, shapeData);
+	const std::vector<size_t> rulePackageEnds = getRulePackageEnds(shapeData, generateIndices);
+	if (useRadiusOcclusion)
+		occlusionGrid = std::make_unique<SpatialGrid>(shapeBounds, occlusionRadius);
+
+	// the state is only valid again once this cook completes
+	mGeneratedSettingsHash = 0;
+	mGeneratedShapes.clear();
+
+	const size_t numGenerate = generateIndices.size();
+	InitialShapeNOPtrVector generateShapes(numGenerate);
+	std::vector<uint64_t> generateHashes(numGenerate);
+	for (size_t gi = 0; gi < numGenerate; gi++) {
+		generateShapes[gi] = is[generateIndices[gi]];
+		generateHashes[gi] = shapeHashes[generateIndices[gi]];
+	}
+
+	// split the cores between concurrent generate calls (node parameter, then environment, then automatic)
+	// and the PRT worker threads of each call
+	const size_t requestedBatches = [this, &context]() -> size_t {
+		const size_t b = GenerateNodeParams::getGenerateBatches(this, context.getTime());
+		return (b > 0) ? b : mPRTCtx->mGenerateBatches;
+	}();
+	const ThreadBudget threadBudget = getThreadBudget(mPRTCtx->mCores, numGenerate, requestedBatches);
+	const size_t nThreads = threadBudget.batches;
+
+	AttributeMapBuilderUPtr generateOptionsBuilder(prt::AttributeMapBuilder::create());
+	generateOptionsBuilder->setInt(L"numberWorkerThreads", static_cast<int32_t>(threadBudget.workersPerBatch));
+	mGenerateOptions.reset(generateOptionsBuilder->createAttributeMapAndReset());
+
+	// establish the amount of initial shapes handed out per generate call (0 means automatic)
+	const size_t requestedChunkSize = GenerateNodeParams::getChunkSize(this, context.getTime());
+	const size_t chunkSize = (requestedChunkSize > 0) ? requestedChunkSize
+	                                                  : ChunkScheduler::getDefaultChunkSize(numGenerate, nThreads);
+
+	// optionally balance the chunks by the estimated generate cost instead of the number of initial shapes
+	const auto batchBalancing = GenerateNodeParams::getBatchBalancing(this, context.getTime());
+	const std::vector<double> costs = estimateCosts(shapeData, *mPRTCtx->mCostModel);
+	std::vector<double> generateCosts(numGenerate);
+	for (size_t gi = 0; gi < numGenerate; gi++)
+		generateCosts[gi] = costs[generateIndices[gi]];
+	auto createScheduler = [&](const std::vector<double>& itemCosts, const std::vector<size_t>& groupEnds) {
+		if (batchBalancing == GenerateNodeParams::BatchBalancing::COST)
+			return std::make_unique<ChunkScheduler>(itemCosts, requestedChunkSize, nThreads, groupEnds);
+		return std::make_unique<ChunkScheduler>(itemCosts.size(), requestedChunkSize, nThreads, groupEnds);
+	};
 
 	// prepare generate status receivers
-	std::vector<prt::Status> initialShapeStatus(is.size(), prt::STATUS_OK);
+	std::vector<prt::Status> occlusionStatus(is.size(), prt::STATUS_OK);
+	std::vector<prt::Status> generateStatus(numGenerate, prt::STATUS_OK);
+
+	if (!pollInterrupt(progress, cancellation)) {
+		if (canReusePrimitives)
+			destroyOutdatedPrimitives(gdp, upToDateShapes);
+		else
+			gdp->clearAndDestroy();
+
+		// the materials of all converters are collected in one table, the reused primitives keep their indices
+		MaterialTable materialTable;
+		if (useMaterialTable && canReusePrimitives)
+			materialTable.read(gdp);
+
+		// add the cached models first, they do not depend on the generate passes below
+		std::vector<prt::Status> cachedStatus(cachedIndices.size(), prt::STATUS_OK);
+		std::vector<uint64_t> cachedHashes(cachedIndices.size());
+		for (size_t ci = 0; ci < cachedIndices.size(); ci++)
+			cachedHashes[ci] = shapeHashes[cachedIndices[ci]];
+		const bool bridgeHoles = GenerateNodeParams::getBridgeHoles(this, context.getTime());
+		PrimitiveCreation cachedPrimitiveCreation;
+		cachedPrimitiveCreation.bridgeHoles = bridgeHoles;
+		cachedPrimitiveCreation.packPrimitives = packPrimitives;
+		cachedPrimitiveCreation.materialTable = useMaterialTable ? &materialTable : nullptr;
+		ModelConverter cachedModelConverter(gdp, mDetailMutex, groupCreation, cachedStatus, &cancellation,
+		                                    incremental ? &cachedHashes : nullptr, nullptr, cachedPrimitiveCreation);
+		if (!cachedModels.empty()) {
+			WA("add cached models");
+			for (size_t ci = 0; ci < cachedIndices.size(); ci++) {
+				const InitialShapeInfo& info = shapeData.getInitialShapeInfo(cachedIndices[ci]);
+				cachedModelConverter.add(ci, shapeData.getInitialShapeName(info.builderIndex).c_str(),
+				                         *cachedModels[ci]);
+			}
+		}
 
-	if (!progress.wasInterrupted()) {
-		gdp->clearAndDestroy();
-		{
+		bool batchesSucceeded = true;
+		if (numGenerate > 0) {
 			WA("generate");
 
 			// prt requires one callback instance per generate call
-			std::vector<ModelConverterUPtr> modelConverters(nThreads);
-			std::generate(modelConverters.begin(), modelConverters.end(),
-			              [this, &groupCreation, &initialShapeStatus, &progress]() -> ModelConverterUPtr {
-				              return ModelConverterUPtr(
-				                      new ModelConverter(gdp, groupCreation, initialShapeStatus, &progress));
-			              });
+			auto createModelConverters = [&](std::vector<prt::Status>& statuses, const std::vector<uint64_t>* hashes,
+			                                 ModelConverter::GeneratedModels* generatedModels,
+			                                 const PrimitiveCreation& primitiveCreation) {
+				std::vector<ModelConverterUPtr> modelConverters(nThreads);
+				std::generate(modelConverters.begin(), modelConverters.end(), [&]() -> ModelConverterUPtr {
+					return ModelConverterUPtr(new ModelConverter(gdp, mDetailMutex, groupCreation, statuses,
+					                                             &cancellation, hashes, generatedModels,
+					                                             primitiveCreation));
+				});
+				return modelConverters;
+			};
+			auto succeeded = [](const std::vector<prt::Status>& batchStatus) {
+				return std::all_of(batchStatus.begin(), batchStatus.end(),
+				                   [](prt::Status s) { return s == prt::STATUS_OK; });
+			};
+
+			// the occlusion pass is skipped if the rules do not query occlusion (automatic) or is run per chunk
+			using GenerateNodeParams::OcclusionMode;
+			const bool globalOcclusion =
+			        (occlusionMode == OcclusionMode::GLOBAL) ||
+			        (occlusionMode == OcclusionMode::AUTOMATIC && usesOcclusion(*mPRTCtx, shapeData, generateIndices));
+			std::vector<prt::OcclusionSet::Handle> occlusionHandles(globalOcclusion ? is.size() : 0);
+			OcclusionSetUPtr occlusionSet{globalOcclusion ? prt::OcclusionSet::create() : nullptr};
+
+			LOG_INF << getName() << ": calling generate: #initial shapes = " << numGenerate << " (of " << is.size()
+			        << ", up to date = " << upToDateShapes.size() << ", cached = " << cachedModels.size()
+			        << "), #cores = "
+			        << mPRTCtx->mCores << ", #batches = " << nThreads << ((requestedBatches > 0) ? "" : " (automatic)")
+			        << ", PRT worker threads per batch = " << threadBudget.workersPerBatch
+			        << ", initial shapes per chunk = " << chunkSize
+			        << ((requestedChunkSize > 0) ? "" : " (automatic)") << ", chunks balanced by "
+			        << ((batchBalancing == GenerateNodeParams::BatchBalancing::COST) ? "estimated cost" : "count")
+			        << ", occlusion pass: "
+			        << (globalOcclusion                           ? "all initial shapes"
+			            : (occlusionMode == OcclusionMode::CHUNK)  ? "per chunk"
+			            : (occlusionMode == OcclusionMode::RADIUS) ? "per chunk and neighbours"
+			                                                       : "skipped");
+
+			// the occluders of all initial shapes are required, the regenerated shapes might query their neighbours
+			std::vector<prt::OcclusionSet::Handle> generateOcclusionHandles;
+			if (globalOcclusion) {
+				auto occlusionConverters =
+				        createModelConverters(occlusionStatus, nullptr, nullptr, PrimitiveCreation());
+				const auto occlusionScheduler = createScheduler(costs, {});
+				batchesSucceeded &= succeeded(batchGenerate(
+				        *mPRTCtx->mThreadPool, BatchMode::OCCLUSION, nThreads, occlusionConverters,
+				        *occlusionScheduler, is, mAllEncoders, mAllEncoderOptions, occlusionHandles, occlusionSet,
+				        mPRTCtx->mPRTCache, mGenerateOptions, progress, cancellation));
+
+				generateOcclusionHandles.resize(numGenerate);
+				for (size_t gi = 0; gi < numGenerate; gi++)
+					generateOcclusionHandles[gi] = occlusionHandles[generateIndices[gi]];
+			}
+
+			// measure the generation pass in any mode, so switching to cost balancing benefits from earlier cooks
+			ChunkTimings chunkTimings;
+			ModelConverter::GeneratedModels generatedModels(useModelCache ? numGenerate : 0);
+			// concurrent batches write into their own staging details which are merged into gdp at the end
+			PrimitiveCreation primitiveCreation;
+			primitiveCreation.stageGeometry = (nThreads > 1);
+			primitiveCreation.deferPrimitives = GenerateNodeParams::getDeferPrimitives(this, context.getTime());
+			primitiveCreation.bridgeHoles = bridgeHoles;
+			primitiveCreation.packPrimitives = packPrimitives;
+			primitiveCreation.materialTable = cachedPrimitiveCreation.materialTable;
+			auto generationConverters =
+			        createModelConverters(generateStatus, incremental ? &generateHashes : nullptr,
+			                              useModelCache ? &generatedModels : nullptr, primitiveCreation);
+			const auto generationScheduler = createScheduler(generateCosts, rulePackageEnds);
+			const bool chunkOcclusion =
+			        (occlusionMode == OcclusionMode::CHUNK || occlusionMode == OcclusionMode::RADIUS);
+			const BatchMode generationMode =
+			        chunkOcclusion ? BatchMode::GENERATION_WITH_CHUNK_OCCLUSION : BatchMode::GENERATION;
+
+			// the occluders of the chunks are generated by their own converters (one status vector per batch, indexed
+			// by the chunk's initial shapes or its neighbours)
+			std::vector<std::vector<prt::Status>> chunkOcclusionStatus;
+			std::vector<ModelConverterUPtr> chunkOcclusionConverters;
+			std::unique_ptr<ChunkOcclusion> chunkOcclusionData;
+			if (chunkOcclusion) {
+				for (size_t ti = 0; ti < nThreads; ti++)
+					chunkOcclusionStatus.emplace_back(is.size(), prt::STATUS_OK);
+				for (size_t ti = 0; ti < nThreads; ti++)
+					chunkOcclusionConverters.emplace_back(new ModelConverter(gdp, mDetailMutex, groupCreation,
+					                                                         chunkOcclusionStatus[ti], &cancellation));
+				chunkOcclusionData.reset(new ChunkOcclusion{&chunkOcclusionConverters, {}});
+			}
 
-			std::vector<prt::OcclusionSet::Handle> occlusionHandles(is.size());
-			OcclusionSetUPtr occlusionSet{prt::OcclusionSet::create()};
+			// the neighbours of a chunk: all initial shapes (generated or not) within the radius of its initial shapes
+			if (occlusionGrid && chunkOcclusionData) {
+				chunkOcclusionData->getNeighbours = [&](const ChunkScheduler::Chunk& chunk) {
+					std::vector<size_t> neighbourIndices;
+					for (size_t gi = chunk.begin; gi < chunk.end; gi++) {
+						const std::vector<size_t> n =
+						        occlusionGrid->query(shapeBounds[generateIndices[gi]], occlusionRadius);
+						neighbourIndices.insert(neighbourIndices.end(), n.begin(), n.end());
+					}
+					std::sort(neighbourIndices.begin(), neighbourIndices.end());
+					neighbourIndices.erase(std::unique(neighbourIndices.begin(), neighbourIndices.end()),
+					                       neighbourIndices.end());
+
+					// the occluders of the chunk's own initial shapes are already there
+					std::vector<size_t> chunkIndices(generateIndices.begin() + chunk.begin,
+					                                 generateIndices.begin() + chunk.end);
+					std::sort(chunkIndices.begin(), chunkIndices.end());
+					InitialShapeNOPtrVector neighbours;
+					for (const size_t isIdx : neighbourIndices) {
+						if (!std::binary_search(chunkIndices.begin(), chunkIndices.end(), isIdx))
+							neighbours.push_back(is[isIdx]);
+					}
+					return neighbours;
+				};
+			}
 
-			LOG_INF << getName() << ": calling generate: #initial shapes = " << is.size() << ", #threads = " << nThreads
-			        << ", initial shapes per thread = " << isRangeSize;
+			batchesSucceeded &= succeeded(batchGenerate(
+			        *mPRTCtx->mThreadPool, generationMode, nThreads, generationConverters, *generationScheduler,
+			        generateShapes, mAllEncoders, mAllEncoderOptions, generateOcclusionHandles, occlusionSet,
+			        mPRTCtx->mPRTCache, mGenerateOptions, progress, cancellation, &chunkTimings,
+			        chunkOcclusionData.get()));
+			if (chunkOcclusionData && chunkOcclusionData->getNeighbours)
+				LOG_INF << getName() << ": generated " << chunkOcclusionData->numNeighbourOccluders
+				        << " neighbour occluders for " << numGenerate << " initial shapes";
+			updateCostModel(*mPRTCtx->mCostModel, shapeData, generateIndices, costs, chunkTimings);
+			logRulePackageTimings(shapeData, generateIndices, chunkTimings);
+
+			if (occlusionSet)
+				occlusionSet->dispose(occlusionHandles.data(), occlusionHandles.size());
+
+			// cancelled generate calls might have delivered incomplete models
+			if (useModelCache && !pollInterrupt(progress, cancellation)) {
+				std::vector<std::pair<uint64_t, GeneratedModelSPtr>> newModels;
+				for (size_t gi = 0; gi < numGenerate; gi++) {
+					const size_t isIdx = generateIndices[gi];
+					if (!isCacheable(isIdx) || generateStatus[gi] != prt::STATUS_OK ||
+					    occlusionStatus[isIdx] != prt::STATUS_OK)
+						continue;
+					GeneratedModelSPtr model = generatedModels[gi] ? std::move(generatedModels[gi])
+					                                               : std::make_shared<GeneratedModel>();
+					modelCache.insert(getModelKey(isIdx), model);
+					newModels.emplace_back(getModelKey(isIdx), std::move(model));
+				}
+				if (diskCache) {
+					WA("write cached models");
+					mPRTCtx->mThreadPool->parallelFor(newModels.size(), [&](size_t mi) {
+						diskCache->put(newModels[mi].first, *newModels[mi].second);
+					});
+				}
+			}
 
-			batchGenerate(BatchMode::OCCLUSION, nThreads, modelConverters, isRangeSize, is, mAllEncoders,
-			              mAllEncoderOptions, occlusionHandles, occlusionSet, mPRTCtx->mPRTCache, mGenerateOptions);
+			// all generate calls are done, each converter now creates its deferred primitives (if any) and runs
+			// buildHoles on its collected primitive groups, concurrently if they write into their own staging details
+			auto completeGeometry = [&generationConverters, &primitiveCreation](size_t ci) {
+				if (primitiveCreation.deferPrimitives)
+					generationConverters[ci]->createDeferredPrimitives();
+				generationConverters[ci]->buildHoles();
+			};
+			{
+				WA("complete geometry");
+				if (primitiveCreation.stageGeometry) {
+					// the cached models are in gdp, i.e. their holes can be built at the same time
+					mPRTCtx->mThreadPool->parallelFor(generationConverters.size() + 1, [&](size_t ci) {
+						if (ci < generationConverters.size())
+							completeGeometry(ci);
+						else
+							cachedModelConverter.buildHoles();
+					});
+				}
+				else {
+					for (size_t ci = 0; ci < generationConverters.size(); ci++)
+						completeGeometry(ci);
+				}
+			}
 
-			batchGenerate(BatchMode::GENERATION, nThreads, modelConverters, isRangeSize, is, mAllEncoders,
-			              mAllEncoderOptions, occlusionHandles, occlusionSet, mPRTCtx->mPRTCache, mGenerateOptions);
+			if (primitiveCreation.stageGeometry) {
+				WA("merge staging details");
+				ModelConverter::mergeStagingDetails(*mPRTCtx->mThreadPool, generationConverters);
+			}
+		}
+		else
+			LOG_INF << getName() << ": nothing to generate, " << upToDateShapes.size() << " initial shapes up to date, "
+			        << cachedModels.size() << " taken from the model cache";
+		cachedModelConverter.buildHoles(); // no-op if already done above
+		if (useMaterialTable)
+			materialTable.write(gdp);
+
+		if (useModelCache) {
+			const GeneratedModelCache::Stats stats = modelCache.getStats();
+			LOG_INF << getName() << ": model cache: #hits = " << stats.hits << ", #misses = " << stats.misses
+			        << ", #entries = " << stats.entries << ", #evictions = " << stats.evictions
+			        << ", MB used = " << stats.bytes / (1024 * 1024) << " of " << stats.budget / (1024 * 1024);
+		}
+		if (diskCache) {
+			const GeneratedModelDiskCache::Stats stats = diskCache->getStats();
+			LOG_INF << getName() << ": model cache directory " << modelCacheDir << ": #hits = " << stats.hits
+			        << ", #misses = " << stats.misses << ", #writes = " << stats.writes
+			        << ", #failed writes = " << stats.failedWrites;
+			if (stats.failedWrites > 0)
+				LOG_WRN << getName() << ": could not write " << stats.failedWrites << " models to " << modelCacheDir;
+		}
 
-			occlusionSet->dispose(occlusionHandles.data(), occlusionHandles.size());
+		// remember the primitives of the successfully generated initial shapes for the next incremental cook
+		if (incremental && batchesSucceeded && !pollInterrupt(progress, cancellation)) {
+			std::vector<bool> generateFailed(is.size(), false);
+			for (size_t gi = 0; gi < numGenerate; gi++) {
+				const size_t isIdx = generateIndices[gi];
+				generateFailed[isIdx] =
+				        (generateStatus[gi] != prt::STATUS_OK || occlusionStatus[isIdx] != prt::STATUS_OK);
+			}
 
-			// all modification of gdb is done, now it is safe to run buildHoles on the
-			// collected primitive groups
-			for (auto& modelConverter : modelConverters)
-				modelConverter->buildHoles();
+			const std::unordered_map<uint64_t, size_t> primCounts = countPrimitivesPerShape(gdp);
+			for (size_t isIdx = 0; isIdx < is.size(); isIdx++) {
+				if (generateFailed[isIdx])
+					continue;
+				const auto primIt = primCounts.find(shapeHashes[isIdx]);
+				mGeneratedShapes[shapeHashes[isIdx]] = (primIt != primCounts.end()) ? primIt->second : 0;
+			}
+			mGeneratedSettingsHash = settingsHash;
 		}
+
 		select();
 	}
 
@@ -213,7 +979,12 @@ OP_ERROR SOPGenerate::cookMySop(OP_Context& context) {
 	unlockInputs();
 
 	// generate status check: if all shapes fail, we abort cooking (failure of individual shapes is sometimes expected)
-	const size_t isSuccesses = std::count(initialShapeStatus.begin(), initialShapeStatus.end(), prt::STATUS_OK);
+	// up-to-date and cached initial shapes have been generated successfully in an earlier cook
+	size_t isSuccesses = is.size() - numGenerate;
+	for (size_t gi = 0; gi < numGenerate; gi++) {
+		if (generateStatus[gi] == prt::STATUS_OK && occlusionStatus[generateIndices[gi]] == prt::STATUS_OK)
+			isSuccesses++;
+	}
 	if (isSuccesses == 0) {
 		LOG_ERR << getName() << ": All initial shapes failed to generate, cooking aborted.";
 		addError(SOP_MESSAGE, "All initial shapes failed to generate.");
@@ -23,6 +23,9 @@
 
 #include "SOP/SOP_Node.h"
 
+#include <mutex>
+#include <unordered_map>
+
 class SOPGenerate : public SOP_Node {
 public:
 	SOPGenerate(const PRTContextUPtr& pCtx, OP_Network* net, const char* name, OP_Operator* op);
@@ -45,4 +48,11 @@ private:
 	std::vector<const wchar_t*> mAllEncoders;
 	AttributeMapNOPtrVector mAllEncoderOptions;
 	AttributeMapUPtr mGenerateOptions;
+
+	// guards our output detail while generate threads write into it, other nodes cook without waiting for it
+	std::mutex mDetailMutex;
+
+	// incremental mode: settings and number of generated primitives per initial shape hash of the last complete cook
+	uint64_t mGeneratedSettingsHash = 0;
+	std::unordered_map<uint64_t, size_t> mGeneratedShapes;
 };
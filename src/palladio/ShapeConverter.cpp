@@ -16,6 +16,7 @@
 
 #include "ShapeConverter.h"
 #include "AttributeConversion.h"
+#include "ContentHash.h"
 #include "LogHandler.h"
 #include "MultiWatch.h"
 #include "PrimitiveClassifier.h"
@@ -67,6 +68,27 @@ struct ConversionHelper {
 
 		return isb;
 	}
+
+	// only the referenced coordinates contribute, the coordinate array is shared by all initial shapes
+	uint64_t getHash() const {
+		ContentHash hash;
+		hash.add(indices.size());
+		for (const uint32_t idx : indices)
+			hash.add(&coords[3 * idx], 3 * sizeof(double));
+		hash.add(faceCounts).add(holes);
+		for (size_t u = 0; u < uvHandles.size(); u++) {
+			if (!uvHandles[u].isInvalid())
+				hash.add(u).add(uvSets[u].uvs);
+		}
+		return hash.get();
+	}
+
+	BoundingBox getBoundingBox() const {
+		BoundingBox bounds;
+		for (const uint32_t idx : indices)
+			bounds.add(coords[3 * idx + 0], coords[3 * idx + 1], coords[3 * idx + 2]);
+		return bounds;
+	}
 };
 
 // transfer texture coordinates
@@ -237,7 +259,9 @@ void ShapeConverter::get(const GU_Detail* detail, const PrimitiveClassifier& pri
 
 		const int32_t randomSeed = getRandomSeed(detail, pIt->second.front()->getMapOffset(), coords, ch);
 		InitialShapeBuilderUPtr isb = ch.createInitialShape();
-		shapeData.addBuilder(std::move(isb), randomSeed, pIt->second, pIt->first);
+		const InitialShapeGeometryStats geometryStats{ch.faceCounts.size(), ch.indices.size(), ch.getHash(),
+		                                              ch.getBoundingBox()};
+		shapeData.addBuilder(std::move(isb), randomSeed, pIt->second, pIt->first, geometryStats);
 	} // for each primitive partition
 
 	assert(shapeData.isValid());
@@ -56,10 +56,12 @@ ShapeData::~ShapeData() {
 }
 
 void ShapeData::addBuilder(InitialShapeBuilderUPtr&& isb, int32_t randomSeed, const PrimitiveNOPtrVector& primMappings,
-                           const PrimitivePartition::ClassifierValueType& clsVal) {
+                           const PrimitivePartition::ClassifierValueType& clsVal,
+                           const InitialShapeGeometryStats& geometryStats) {
 	mInitialShapeBuilders.emplace_back(std::move(isb));
 	mRandomSeeds.push_back(randomSeed);
 	mPrimitiveMapping.emplace_back(primMappings);
+	mGeometryStats.push_back(geometryStats);
 
 	if (mGroupCreation == GroupCreation::PRIMCLS) {
 		std::wstring name;
@@ -69,8 +71,10 @@ void ShapeData::addBuilder(InitialShapeBuilderUPtr&& isb, int32_t randomSeed, co
 	}
 }
 
-void ShapeData::addShape(const prt::InitialShape* is, AttributeMapBuilderUPtr&& amb, AttributeMapUPtr&& ruleAttr) {
+void ShapeData::addShape(const prt::InitialShape* is, AttributeMapBuilderUPtr&& amb, AttributeMapUPtr&& ruleAttr,
+                         InitialShapeInfo&& info) {
 	mInitialShapes.emplace_back(is);
+	mInitialShapeInfos.emplace_back(std::move(info));
 	mRuleAttributeBuilders.emplace_back(std::move(amb));
 	mRuleAttributes.emplace_back(std::move(ruleAttr));
 }
@@ -93,11 +97,14 @@ bool ShapeData::isValid() const {
 	const size_t numAM = mRuleAttributes.size();
 
 	const size_t numPM = mPrimitiveMapping.size();
+	const size_t numGS = mGeometryStats.size();
+	const size_t numISI = mInitialShapeInfos.size();
 
-	if (numPM == 0 || numISB != numPM || (numISB != numISN && numISN > 0) || (numISB == 0 && numISN > 0))
+	if (numPM == 0 || numISB != numPM || numISB != numGS || (numISB != numISN && numISN > 0) ||
+	    (numISB == 0 && numISN > 0))
 		return false;
 
-	if (numIS != numAMB || numIS != numAM) // they are allowed to be all 0
+	if (numIS != numAMB || numIS != numAM || numIS != numISI) // they are allowed to be all 0
 		return false;
 
 	return true;
@@ -18,12 +18,32 @@
 
 #include "NodeParameter.h"
 #include "PrimitivePartition.h"
+#include "SpatialGrid.h"
 #include "Utils.h"
 
 #include "GA/GA_Primitive.h"
 
+#include <filesystem>
+#include <string>
+#include <vector>
+
 using PrimitiveNOPtrVector = std::vector<const GA_Primitive*>;
 
+struct InitialShapeGeometryStats {
+	size_t numFaces = 0;
+	size_t numVertices = 0; // face vertices, i.e. shared points are counted per face
+	uint64_t hash = 0;      // content hash of the geometry (coordinates, faces, holes and uvs)
+	BoundingBox bounds;
+};
+
+struct InitialShapeInfo {
+	size_t builderIndex = 0; // index into the builders, primitive mappings and geometry stats
+	std::filesystem::path rpk;
+	std::wstring ruleFile;  // key of the compiled rule file (cgb) in the rpk
+	std::wstring startRule; // fully qualified
+	uint64_t hash = 0;      // content hash of all generate inputs, see ShapeGenerator::get
+};
+
 class ShapeData final {
 public:
 	ShapeData() = default;
@@ -33,9 +53,11 @@ public:
 	~ShapeData();
 
 	void addBuilder(InitialShapeBuilderUPtr&& isb, int32_t randomSeed, const PrimitiveNOPtrVector& primMappings,
-	                const PrimitivePartition::ClassifierValueType& clsVal);
+	                const PrimitivePartition::ClassifierValueType& clsVal,
+	                const InitialShapeGeometryStats& geometryStats = {});
 
-	void addShape(const prt::InitialShape* is, AttributeMapBuilderUPtr&& amb, AttributeMapUPtr&& ruleAttr);
+	void addShape(const prt::InitialShape* is, AttributeMapBuilderUPtr&& amb, AttributeMapUPtr&& ruleAttr,
+	              InitialShapeInfo&& info = {});
 
 	InitialShapeBuilderVector& getInitialShapeBuilders() {
 		return mInitialShapeBuilders;
@@ -49,6 +71,9 @@ public:
 	const PrimitiveNOPtrVector& getPrimitiveMapping(size_t isIdx) const {
 		return mPrimitiveMapping[isIdx];
 	}
+	const InitialShapeGeometryStats& getGeometryStats(size_t isIdx) const {
+		return mGeometryStats[isIdx];
+	}
 
 	AttributeMapBuilderVector& getRuleAttributeMapBuilders() {
 		return mRuleAttributeBuilders;
@@ -61,14 +86,19 @@ public:
 	const InitialShapeNOPtrVector& getInitialShapes() const {
 		return mInitialShapes;
 	}
+	const InitialShapeInfo& getInitialShapeInfo(size_t isIdx) const {
+		return mInitialShapeInfos[isIdx];
+	}
 
 	bool isValid() const;
 
 private:
 	std::vector<PrimitiveNOPtrVector> mPrimitiveMapping;
+	std::vector<InitialShapeGeometryStats> mGeometryStats;
 
 	InitialShapeBuilderVector mInitialShapeBuilders;
 	InitialShapeNOPtrVector mInitialShapes;
+	std::vector<InitialShapeInfo> mInitialShapeInfos;
 
 	AttributeMapBuilderVector mRuleAttributeBuilders;
 	AttributeMapVector mRuleAttributes;
@@ -16,6 +16,7 @@
 
 #include "ShapeGenerator.h"
 #include "AttributeConversion.h"
+#include "ContentHash.h"
 #include "LogHandler.h"
 #include "MultiWatch.h"
 #include "PrimitiveClassifier.h"
@@ -26,6 +27,8 @@
 #include "GA/GA_Primitive.h"
 #include "GU/GU_Detail.h"
 
+#include <filesystem>
+#include <map>
 #include <unordered_map>
 
 namespace {
@@ -42,6 +45,17 @@ std::wstring getFullyQualifiedStartRule(const MainAttributes& ma) {
 		return ma.mStyle + L'$' + ma.mStartRule;
 }
 
+// the resolve map cache reloads a rule package when its time stamp changes, the shape hash must follow
+int64_t getTimeStamp(const std::filesystem::path& rpk, std::map<std::filesystem::path, int64_t>& timeStamps) {
+	auto it = timeStamps.find(rpk);
+	if (it == timeStamps.end()) {
+		std::error_code ec;
+		const auto ts = std::filesystem::last_write_time(rpk, ec);
+		it = timeStamps.emplace(rpk, ec ? 0 : static_cast<int64_t>(ts.time_since_epoch().count())).first;
+	}
+	return it->second;
+}
+
 } // namespace
 
 void ShapeGenerator::get(const GU_Detail* detail, const PrimitiveClassifier& primCls, ShapeData& shapeData,
@@ -81,6 +95,8 @@ void ShapeGenerator::get(const GU_Detail* detail, const PrimitiveClassifier& pri
 		}
 	}
 
+	std::map<std::filesystem::path, int64_t> rpkTimeStamps;
+
 	// loop over all initial shapes and use the first primitive to get the attribute values
 	for (size_t isIdx = 0; isIdx < shapeData.getInitialShapeBuilders().size(); isIdx++) {
 		const auto& pv = shapeData.getPrimitiveMapping(isIdx);
@@ -133,7 +149,18 @@ void ShapeGenerator::get(const GU_Detail* detail, const PrimitiveClassifier& pri
 		if (status == prt::STATUS_OK && initialShape != nullptr) {
 			if (DBG)
 				LOG_DBG << objectToXML(initialShape);
-			shapeData.addShape(initialShape, std::move(amb), std::move(ruleAttr));
+			// identifies the generated model independent of the node and shape name (which only affect the groups)
+			ContentHash hash;
+			hash.add(shapeData.getGeometryStats(isIdx).hash)
+			        .add(ma.mRPK.wstring())
+			        .add(getTimeStamp(ma.mRPK, rpkTimeStamps))
+			        .add(ruleFile)
+			        .add(fqStartRule)
+			        .add(randomSeed)
+			        .add(ruleAttr.get());
+
+			shapeData.addShape(initialShape, std::move(amb), std::move(ruleAttr),
+			                   {isIdx, ma.mRPK, ruleFile, fqStartRule, hash.get()});
 		}
 		else
 			LOG_WRN << "failed to create initial shape " << shapeName << ": " << prt::getStatusDescription(status);
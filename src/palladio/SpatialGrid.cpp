@@ -0,0 +1,157 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// limits the memory of the grid for very small cells compared to the extent of the boxes
+constexpr double MAX_CELLS_PER_AXIS = 1024.0;
+
+// keeps the cell coordinates well within the range of int64_t, e.g. for far away boxes with zero extent
+constexpr double MAX_CELL_COORDINATE = 1e15;
+
+// spreads the 32 bits of v to the even bits of the result
+uint64_t interleaveZeros(uint32_t v) {
+	uint64_t x = v;
+	x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+	x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+	x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+	x = (x | (x << 2)) & 0x3333333333333333ull;
+	x = (x | (x << 1)) & 0x5555555555555555ull;
+	return x;
+}
+
+uint32_t quantize(double v, double lo, double hi) {
+	if (!(hi > lo))
+		return 0;
+	const double t = std::clamp((v - lo) / (hi - lo), 0.0, 1.0);
+	return static_cast<uint32_t>(t * std::numeric_limits<uint32_t>::max());
+}
+
+} // namespace
+
+uint64_t getMortonCode(const BoundingBox& box, const BoundingBox& extent) {
+	if (box.isEmpty() || extent.isEmpty())
+		return 0;
+	const uint32_t x = quantize(0.5 * (box.min[0] + box.max[0]), extent.min[0], extent.max[0]);
+	const uint32_t z = quantize(0.5 * (box.min[2] + box.max[2]), extent.min[2], extent.max[2]);
+	return interleaveZeros(x) | (interleaveZeros(z) << 1);
+}
+
+void BoundingBox::add(double x, double y, double z) {
+	const std::array<double, 3> p = {x, y, z};
+	for (size_t d = 0; d < 3; d++) {
+		min[d] = std::min(min[d], p[d]);
+		max[d] = std::max(max[d], p[d]);
+	}
+}
+
+bool BoundingBox::isEmpty() const {
+	return min[0] > max[0];
+}
+
+double BoundingBox::getDistance(const BoundingBox& other) const {
+	double sq = 0.0;
+	for (size_t d = 0; d < 3; d++) {
+		const double gap = std::max({0.0, other.min[d] - max[d], min[d] - other.max[d]});
+		sq += gap * gap;
+	}
+	return std::sqrt(sq);
+}
+
+SpatialGrid::SpatialGrid(const std::vector<BoundingBox>& boxes, double cellSize)
+    : mBoxes(boxes), mCellSize(cellSize) {
+	BoundingBox all;
+	for (const BoundingBox& b : boxes) {
+		if (b.isEmpty())
+			continue;
+		all.add(b.min[0], b.min[1], b.min[2]);
+		all.add(b.max[0], b.max[1], b.max[2]);
+	}
+	if (all.isEmpty())
+		return;
+
+	const double extent = std::max(all.max[0] - all.min[0], all.max[2] - all.min[2]);
+	const double magnitude =
+	        std::max({std::abs(all.min[0]), std::abs(all.max[0]), std::abs(all.min[2]), std::abs(all.max[2])});
+	mCellSize = std::max({mCellSize, extent / MAX_CELLS_PER_AXIS, magnitude / MAX_CELL_COORDINATE});
+	if (!(mCellSize > 0.0)) // zero radius and all boxes collapsed onto the origin: a single cell
+		mCellSize = 1.0;
+
+	mOrigin = getCell(all.min[0], all.min[2]);
+	const Cell last = getCell(all.max[0], all.max[2]);
+	mColumns = last.first - mOrigin.first + 1;
+	mRows = last.second - mOrigin.second + 1;
+
+	for (size_t i = 0; i < boxes.size(); i++) {
+		const BoundingBox& b = boxes[i];
+		if (b.isEmpty())
+			continue;
+		const Cell lo = getCell(b.min[0], b.min[2]);
+		const Cell hi = getCell(b.max[0], b.max[2]);
+		for (int64_t cz = lo.second; cz <= hi.second; cz++) {
+			for (int64_t cx = lo.first; cx <= hi.first; cx++)
+				mCells[getKey({cx, cz})].push_back(i);
+		}
+	}
+}
+
+std::vector<size_t> SpatialGrid::query(const BoundingBox& box, double maxDistance) const {
+	std::vector<size_t> result;
+	if (box.isEmpty() || mCells.empty())
+		return result;
+
+	const Cell lo = clamp(getCell(box.min[0] - maxDistance, box.min[2] - maxDistance));
+	const Cell hi = clamp(getCell(box.max[0] + maxDistance, box.max[2] + maxDistance));
+	for (int64_t cz = lo.second; cz <= hi.second; cz++) {
+		for (int64_t cx = lo.first; cx <= hi.first; cx++) {
+			const auto it = mCells.find(getKey({cx, cz}));
+			if (it == mCells.end())
+				continue;
+			for (const size_t i : it->second) {
+				if (mBoxes[i].getDistance(box) <= maxDistance)
+					result.push_back(i);
+			}
+		}
+	}
+
+	// items spanning several cells are found more than once
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+SpatialGrid::Cell SpatialGrid::getCell(double x, double z) const {
+	// the query boxes are grown by the query distance, i.e. they might reach much further than the items
+	auto toCell = [this](double v) {
+		return static_cast<int64_t>(std::clamp(std::floor(v / mCellSize), -MAX_CELL_COORDINATE, MAX_CELL_COORDINATE));
+	};
+	return {toCell(x), toCell(z)};
+}
+
+SpatialGrid::Cell SpatialGrid::clamp(const Cell& cell) const {
+	return {std::clamp(cell.first, mOrigin.first, mOrigin.first + mColumns - 1),
+	        std::clamp(cell.second, mOrigin.second, mOrigin.second + mRows - 1)};
+}
+
+uint64_t SpatialGrid::getKey(const Cell& cell) const {
+	return static_cast<uint64_t>(cell.second - mOrigin.second) * static_cast<uint64_t>(mColumns) +
+	       static_cast<uint64_t>(cell.first - mOrigin.first);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "PalladioMain.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+struct PLD_TEST_EXPORTS_API BoundingBox {
+	std::array<double, 3> min = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+	                             std::numeric_limits<double>::max()};
+	std::array<double, 3> max = {std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(),
+	                             std::numeric_limits<double>::lowest()};
+
+	void add(double x, double y, double z);
+	bool isEmpty() const;
+	double getDistance(const BoundingBox& other) const; // 0 if the boxes overlap
+};
+
+/**
+ * position of the center of the box along a Morton (Z-order) curve over the ground plane of the extent: boxes with
+ * similar codes are close to each other, the curve only rarely jumps
+ */
+PLD_TEST_EXPORTS_API uint64_t getMortonCode(const BoundingBox& box, const BoundingBox& extent);
+
+/**
+ * uniform grid over the ground plane (x and z, y is up in Houdini) to find the items close to a bounding box
+ * without testing all of them. Each item is registered in all cells its box overlaps, empty boxes are ignored.
+ */
+class PLD_TEST_EXPORTS_API SpatialGrid final {
+public:
+	SpatialGrid(const std::vector<BoundingBox>& boxes, double cellSize);
+
+	// indices of all items whose boxes are at most maxDistance away from the box (including the box's own item)
+	std::vector<size_t> query(const BoundingBox& box, double maxDistance) const;
+
+private:
+	using Cell = std::pair<int64_t, int64_t>;
+	Cell getCell(double x, double z) const;
+	Cell clamp(const Cell& cell) const; // to the cells covered by the boxes
+	uint64_t getKey(const Cell& cell) const;
+
+	const std::vector<BoundingBox> mBoxes;
+	double mCellSize;
+	Cell mOrigin = {0, 0}; // lowest cell
+	int64_t mColumns = 1;
+	int64_t mRows = 1;
+	std::unordered_map<uint64_t, std::vector<size_t>> mCells;
+};
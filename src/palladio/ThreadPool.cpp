@@ -0,0 +1,66 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t numThreads) {
+	const size_t n = std::max<size_t>(numThreads, 1);
+	mThreads.reserve(n);
+	for (size_t ti = 0; ti < n; ti++)
+		mThreads.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mCondition.notify_all();
+	for (std::thread& t : mThreads)
+		t.join();
+}
+
+void ThreadPool::enqueue(std::function<void()>&& task) {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.emplace_back(std::move(task));
+	}
+	mCondition.notify_one();
+}
+
+void ThreadPool::run() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this] { return mStop || !mTasks.empty(); });
+			if (mStop && mTasks.empty())
+				return; // drain remaining tasks before shutting down, somebody might wait for their futures
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+		task();
+	}
+}
+
+ThreadBudget getThreadBudget(size_t cores, size_t numInitialShapes, size_t requestedBatches) {
+	cores = std::max<size_t>(cores, 1);
+	const size_t maxBatches = std::max<size_t>(std::min(cores, numInitialShapes), 1);
+	const size_t batches = (requestedBatches > 0) ? std::min(requestedBatches, maxBatches) : maxBatches;
+	return {batches, std::max<size_t>(cores / batches, 1)};
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2014-2020 Esri R&D Zurich and VRBN
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "PalladioMain.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * fixed-size pool of long-lived worker threads, shared by all palladio nodes:
+ * tasks of concurrently cooking nodes are queued instead of each node starting its own threads.
+ * note: tasks must not wait for other tasks of the same pool, this can dead-lock if all workers are waiting.
+ */
+class PLD_TEST_EXPORTS_API ThreadPool final {
+public:
+	explicit ThreadPool(size_t numThreads);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	ThreadPool& operator=(ThreadPool&&) = delete;
+	~ThreadPool();
+
+	template <typename F>
+	std::future<std::invoke_result_t<F>> submit(F&& f) {
+		using R = std::invoke_result_t<F>;
+		// std::function requires copyable callables, hence the shared task
+		auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+		std::future<R> result = task->get_future();
+		enqueue([task]() { (*task)(); });
+		return result;
+	}
+
+	// runs f(i) for all i in [0, numItems) on the pool and waits for completion, must not be called from a pool task
+	template <typename F>
+	void parallelFor(size_t numItems, F&& f) {
+		const size_t numTasks = std::min(numItems, mThreads.size());
+		std::vector<std::future<void>> futures;
+		futures.reserve(numTasks);
+		for (size_t ti = 0; ti < numTasks; ti++) {
+			futures.emplace_back(submit([&f, ti, numTasks, numItems]() {
+				for (size_t i = ti; i < numItems; i += numTasks)
+					f(i);
+			}));
+		}
+		// all tasks reference f (and the caller's stack through it), i.e. they must be finished before an exception of
+		// one of them is passed on
+		for (auto& fut : futures)
+			fut.wait();
+		for (auto& fut : futures)
+			fut.get();
+	}
+
+	size_t getNumThreads() const {
+		return mThreads.size();
+	}
+
+private:
+	void enqueue(std::function<void()>&& task);
+	void run();
+
+	std::vector<std::thread> mThreads;
+	std::deque<std::function<void()>> mTasks;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mStop = false;
+};
+
+using ThreadPoolUPtr = std::unique_ptr<ThreadPool>;
+
+/**
+ * split of the core budget between concurrent generate calls (batches) and the PRT worker threads of each call,
+ * the product of both does not exceed the number of cores
+ */
+struct ThreadBudget {
+	size_t batches;
+	size_t workersPerBatch;
+};
+
+/**
+ * requestedBatches = 0 selects one batch per core (limited by the number of initial shapes) and distributes
+ * any remaining cores to the PRT workers
+ */
+PLD_TEST_EXPORTS_API ThreadBudget getThreadBudget(size_t cores, size_t numInitialShapes, size_t requestedBatches);
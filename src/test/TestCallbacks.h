@@ -51,15 +51,30 @@ struct CallbackResult {
 	CallbackResult& operator=(CallbackResult&&) = delete;
 };
 
+struct PrototypeResult {
+	size_t calls = 0; // number of addPrototype calls with this key
+	std::vector<double> vtx;
+	std::vector<uint32_t> cnts;
+};
+
+struct InstancesResult {
+	size_t isIndex;
+	uint64_t prototypeKey;
+	std::vector<double> transformations; // 16 values (column-major) per instance
+};
+
 class TestCallbacks : public HoudiniCallbacks {
 public:
 	std::vector<std::unique_ptr<CallbackResult>> results;
 	std::map<int32_t, AttributeMapBuilderUPtr> attrs;
-
-	void add(const wchar_t* name, const double* vtx, size_t vtxSize, const double* nrm, size_t nrmSize,
-	         const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
-	         const uint32_t* holeIndices, size_t holeIndicesSize, const uint32_t* vertexIndices,
-	         size_t vertexIndicesSize, const uint32_t* normalIndices, size_t normalIndicesSize,
+	std::map<uint64_t, PrototypeResult> prototypes;
+	std::vector<InstancesResult> instances;
+
+	void add(size_t isIndex, const wchar_t* name, const double* vtx, size_t vtxSize, const double* nrm,
+	         size_t nrmSize, const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts,
+	         size_t holeCountsSize, const uint32_t* holeIndices, size_t holeIndicesSize,
+	         const uint32_t* vertexIndices, size_t vertexIndicesSize, const uint32_t* normalIndices,
+	         size_t normalIndicesSize,
 	         double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
 	         size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
 	         uint32_t uvSets, const uint32_t* faceRanges, size_t faceRangesSize, const prt::AttributeMap** materials,
@@ -97,6 +112,25 @@ public:
 		attrs.clear();
 	}
 
+	void addPrototype(uint64_t prototypeKey, const double* vtx, size_t vtxSize, const double* nrm, size_t nrmSize,
+	                  const uint32_t* counts, size_t countsSize, const uint32_t* holeCounts, size_t holeCountsSize,
+	                  const uint32_t* holeIndices, size_t holeIndicesSize, const uint32_t* vertexIndices,
+	                  size_t vertexIndicesSize, const uint32_t* normalIndices, size_t normalIndicesSize,
+	                  double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
+	                  size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
+	                  uint32_t uvSets, const uint32_t* faceRanges, size_t faceRangesSize,
+	                  const prt::AttributeMap** materials) override {
+		PrototypeResult& pr = prototypes[prototypeKey];
+		pr.calls++;
+		pr.vtx.assign(vtx, vtx + vtxSize);
+		pr.cnts.assign(counts, counts + countsSize);
+	}
+
+	void addInstances(size_t isIndex, const wchar_t* name, uint64_t prototypeKey, const double* transformations,
+	                  size_t instancesSize, const prt::AttributeMap** reports, const int32_t* shapeIDs) override {
+		instances.push_back({isIndex, prototypeKey, {transformations, transformations + 16 * instancesSize}});
+	}
+
 	prt::Status generateError(size_t isIndex, prt::Status status, const wchar_t* message) override {
 		return prt::STATUS_OK;
 	}
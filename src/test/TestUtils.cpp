@@ -31,7 +31,8 @@ constexpr const wchar_t* FILE_CGA_PRINT = L"CGAPrint.txt";
 
 void generate(TestCallbacks& tc, const PRTContextUPtr& prtCtx, const std::filesystem::path& rpkPath,
               const std::wstring& ruleFile, const std::vector<std::wstring>& initialShapeURIs,
-              const std::vector<std::wstring>& startRules, bool triangulateFacesWithHoles) {
+              const std::vector<std::wstring>& startRules, bool triangulateFacesWithHoles, bool instancing,
+              bool mergeMeshes) {
 	REQUIRE(initialShapeURIs.size() == startRules.size());
 
 	ResolveMapSPtr rpkRM = prtCtx->getResolveMap(rpkPath);
@@ -93,6 +94,8 @@ void generate(TestCallbacks& tc, const PRTContextUPtr& prtCtx, const std::filesy
 	amb->setBool(L"emitMaterials", true);
 	amb->setBool(L"emitReports", true);
 	amb->setBool(L"triangulateFacesWithHoles", triangulateFacesWithHoles);
+	amb->setBool(L"instancing", instancing);
+	amb->setBool(L"mergeMeshes", mergeMeshes);
 	const AttributeMapUPtr rawEncOpts(amb->createAttributeMapAndReset());
 	const AttributeMapUPtr houdiniEncOpts(createValidatedOptions(ENCODER_ID_HOUDINI, rawEncOpts.get()));
 
@@ -17,7 +17,17 @@
 #include "TestCallbacks.h"
 #include "TestUtils.h"
 
+#include "CancellationToken.h"
+#include "ChunkScheduler.h"
+#include "ContentHash.h"
+#include "CostModel.h"
+#include "GeneratedModelCache.h"
+#include "GeneratedModelDiskCache.h"
+#include "HoleBridging.h"
+#include "OcclusionDetection.h"
 #include "PRTContext.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 #include "encoder/HoudiniEncoder.h"
 
@@ -29,7 +39,14 @@
 #include "catch2/catch.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <thread>
 
 namespace {
 
@@ -43,6 +60,52 @@ void compareReversed(const std::vector<T>& a, const std::vector<T>& b) {
 		CHECK(a[i] == b[num - i - 1]);
 }
 
+// all faces of the generated models, the faces of a prototype count once per instance
+size_t countFaces(const TestCallbacks& tc) {
+	size_t faces = 0;
+	for (const auto& cr : tc.results)
+		faces += cr->cnts.size();
+	for (const InstancesResult& ir : tc.instances)
+		faces += tc.prototypes.at(ir.prototypeKey).cnts.size() * (ir.transformations.size() / 16);
+	return faces;
+}
+
+// bounds of all vertices in world coordinates: min x, y, z, max x, y, z
+std::vector<double> getBounds(const TestCallbacks& tc) {
+	std::vector<double> bounds = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+	                              std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest(),
+	                              std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+	auto addVertex = [&bounds](const double* v) {
+		for (size_t c = 0; c < 3; c++) {
+			bounds[c] = std::min(bounds[c], v[c]);
+			bounds[c + 3] = std::max(bounds[c + 3], v[c]);
+		}
+	};
+	for (const auto& cr : tc.results) {
+		for (size_t vi = 0; vi + 2 < cr->vtx.size(); vi += 3)
+			addVertex(&cr->vtx[vi]);
+	}
+	for (const InstancesResult& ir : tc.instances) {
+		const std::vector<double>& vtx = tc.prototypes.at(ir.prototypeKey).vtx;
+		for (size_t ti = 0; ti + 15 < ir.transformations.size(); ti += 16) {
+			const double* m = &ir.transformations[ti]; // column-major
+			for (size_t vi = 0; vi + 2 < vtx.size(); vi += 3) {
+				double v[3];
+				for (size_t r = 0; r < 3; r++)
+					v[r] = m[r] * vtx[vi] + m[4 + r] * vtx[vi + 1] + m[8 + r] * vtx[vi + 2] + m[12 + r];
+				addVertex(v);
+			}
+		}
+	}
+	return bounds;
+}
+
+void compareBounds(const std::vector<double>& a, const std::vector<double>& b) {
+	REQUIRE(a.size() == b.size());
+	for (size_t i = 0; i < a.size(); i++)
+		CHECK(a[i] == Approx(b[i]));
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -621,6 +684,41 @@ TEST_CASE("serialize two meshes where one does not have uvs (issue 108)") {
 	CHECK(sg.uvIndices[0] == expUVIdx);
 }
 
+TEST_CASE("transform serialized instances") {
+	const prtx::DoubleVector vtx = {0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0, 0.0, 1.0, 0.0, 0.0, 1.0};
+	const prtx::IndexVector vtxIdx = {0, 1, 2, 3};
+
+	prtx::MeshBuilder mb;
+	mb.addVertexCoords(vtx);
+	uint32_t faceIdx = mb.addFace();
+	mb.setFaceVertexIndices(faceIdx, vtxIdx);
+	const auto m = mb.createShared();
+
+	prtx::GeometryBuilder gb;
+	gb.addMesh(m);
+	const auto geo1 = gb.createSharedAndReset();
+	gb.addMesh(m);
+	const auto geo2 = gb.createShared();
+	const prtx::GeometryPtrVector geos = {geo1, geo2};
+	const std::vector<prtx::MaterialPtrVector> mats = {m->getMaterials(), m->getMaterials()};
+
+	detail::SerializedGeometry sg = detail::serializeGeometry(geos, mats);
+
+	// column-major: a translation along x and a mirroring at the yz plane
+	const std::vector<prtx::DoubleVector> transformations = {
+	        {1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 10.0, 0.0, 0.0, 1.0},
+	        {-1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0}};
+	detail::transformGeometry(sg, geos, transformations);
+
+	const prtx::DoubleVector expVtx = {10.0, 0.0, 0.0, 11.0, 0.0, 0.0, 11.0, 0.0, 1.0, 10.0, 0.0, 1.0,
+	                                   0.0,  0.0, 0.0, -1.0, 0.0, 0.0, -1.0, 0.0, 1.0, 0.0,  0.0, 1.0};
+	CHECK(sg.coords == expVtx);
+
+	// the mirrored face keeps facing outwards
+	const prtx::IndexVector expVtxIdx = {3, 2, 1, 0, 4, 5, 6, 7};
+	CHECK(sg.vertexIndices == expVtxIdx);
+}
+
 TEST_CASE("generate two cubes with two uv sets") {
 	const std::vector<std::filesystem::path> initialShapeSources = {testDataPath / "quad0.obj",
 	                                                                testDataPath / "quad1.obj"};
@@ -699,6 +797,67 @@ TEST_CASE("generate two cubes with two uv sets") {
 	}
 }
 
+// the test rule packages do not insert the same asset repeatedly, i.e. the generated models might not contain any
+// prototypes: then all geometry has to arrive through add, in world coordinates
+TEST_CASE("generate with instancing keeps all geometry", "[instancing]") {
+	const std::vector<std::wstring> initialShapeURIs = {toFileURI(testDataPath / "quad0.obj"),
+	                                                    toFileURI(testDataPath / "quad1.obj")};
+	const std::vector<std::wstring> startRules = {L"Default$OneSet", L"Default$TwoSets"};
+	const std::filesystem::path rpkPath = testDataPath / "uvsets.rpk";
+	const std::wstring ruleFile = L"bin/r1.cgb";
+
+	TestCallbacks tcPlain;
+	generate(tcPlain, prtCtx, rpkPath, ruleFile, initialShapeURIs, startRules);
+	REQUIRE(tcPlain.prototypes.empty());
+	REQUIRE(tcPlain.instances.empty());
+
+	TestCallbacks tc;
+	generate(tc, prtCtx, rpkPath, ruleFile, initialShapeURIs, startRules, true, true);
+
+	for (const InstancesResult& ir : tc.instances) {
+		// the prototype is reported before its instances, at most once per encoder and initial shape
+		REQUIRE(tc.prototypes.count(ir.prototypeKey) == 1);
+		CHECK(tc.prototypes.at(ir.prototypeKey).calls <= initialShapeURIs.size());
+
+		// a prototype has at least two instances, each with an affine column-major matrix
+		REQUIRE(ir.transformations.size() >= 2 * 16);
+		REQUIRE(ir.transformations.size() % 16 == 0);
+		for (size_t ti = 0; ti < ir.transformations.size(); ti += 16) {
+			CHECK(ir.transformations[ti + 3] == 0.0);
+			CHECK(ir.transformations[ti + 7] == 0.0);
+			CHECK(ir.transformations[ti + 11] == 0.0);
+			CHECK(ir.transformations[ti + 15] == 1.0);
+		}
+	}
+
+	CHECK(countFaces(tc) == countFaces(tcPlain));
+	compareBounds(getBounds(tc), getBounds(tcPlain));
+}
+
+TEST_CASE("generate with merged meshes keeps all geometry", "[instancing]") {
+	const std::vector<std::wstring> initialShapeURIs = {toFileURI(testDataPath / "quad0.obj"),
+	                                                    toFileURI(testDataPath / "quad1.obj")};
+	const std::vector<std::wstring> startRules = {L"Default$OneSet", L"Default$TwoSets"};
+	const std::filesystem::path rpkPath = testDataPath / "uvsets.rpk";
+	const std::wstring ruleFile = L"bin/r1.cgb";
+
+	TestCallbacks tcPlain;
+	generate(tcPlain, prtCtx, rpkPath, ruleFile, initialShapeURIs, startRules);
+
+	TestCallbacks tc;
+	generate(tc, prtCtx, rpkPath, ruleFile, initialShapeURIs, startRules, true, false, true);
+	REQUIRE(tc.results.size() == tcPlain.results.size());
+
+	// one face range per material at most
+	for (size_t ri = 0; ri < tc.results.size(); ri++) {
+		CHECK(tc.results[ri]->name == tcPlain.results[ri]->name);
+		CHECK(tc.results[ri]->faceRanges.size() <= tcPlain.results[ri]->faceRanges.size());
+	}
+
+	CHECK(countFaces(tc) == countFaces(tcPlain));
+	compareBounds(getBounds(tc), getBounds(tcPlain));
+}
+
 TEST_CASE("generate with generic attributes") {
 	const std::vector<std::filesystem::path> initialShapeSources = {testDataPath / "quad0.obj"};
 	const std::vector<std::wstring> initialShapeURIs = {toFileURI(initialShapeSources[0])};
@@ -808,3 +967,656 @@ TEST_CASE("generate without polygon hole triangulation") {
 	CHECK(cr.holeIdx[2] == 28);
 	CHECK(cr.holeIdx[3] == 29);
 }
+
+TEST_CASE("bridge hole of a quad", "[holes]") {
+	// outer quad (counter-clockwise) and a smaller quad hole with the same orientation
+	const std::vector<double> vtx = {0.0, 0.0, 0.0, 4.0, 0.0, 0.0, 4.0, 4.0, 0.0, 0.0, 4.0, 0.0,
+	                                 1.0, 1.0, 0.0, 3.0, 1.0, 0.0, 3.0, 3.0, 0.0, 1.0, 3.0, 0.0};
+	const std::vector<uint32_t> counts = {4, 4};
+	const std::vector<uint32_t> holeCounts = {1, 0};
+	const std::vector<uint32_t> holeIndices = {1};
+	const std::vector<uint32_t> vertexIndices = {0, 1, 2, 3, 4, 5, 6, 7};
+	const std::vector<uint32_t> uvCounts = {4, 4};
+	const std::vector<uint32_t> uvIndices = {10, 11, 12, 13, 14, 15, 16, 17};
+	const uint32_t* uvCountsPtr = uvCounts.data();
+	const uint32_t* uvIndicesPtr = uvIndices.data();
+	const size_t uvCountsSize = uvCounts.size();
+	const size_t uvIndicesSize = uvIndices.size();
+	const std::vector<uint32_t> faceRanges = {0, 2};
+
+	HoleBridging::BridgedFaces bf;
+	REQUIRE(HoleBridging::bridgeHoles(bf, vtx.data(), vtx.size(), counts.data(), counts.size(), holeCounts.data(),
+	                                  holeCounts.size(), holeIndices.data(), holeIndices.size(), vertexIndices.data(),
+	                                  vertexIndices.size(), nullptr, 0, &uvCountsPtr, &uvCountsSize, &uvIndicesPtr,
+	                                  &uvIndicesSize, 1, faceRanges.data(), faceRanges.size()));
+
+	// the hole is reversed and connected to the closest outer corner (0 to 4)
+	CHECK(bf.counts == std::vector<uint32_t>{10});
+	CHECK(bf.vertexIndices == std::vector<uint32_t>{0, 4, 7, 6, 5, 4, 0, 1, 2, 3});
+	CHECK(bf.normalIndices.empty());
+	REQUIRE(bf.uvCounts.size() == 1);
+	CHECK(bf.uvCounts[0] == std::vector<uint32_t>{10});
+	CHECK(bf.uvIndices[0] == std::vector<uint32_t>{10, 14, 17, 16, 15, 14, 10, 11, 12, 13});
+	CHECK(bf.faceRanges == std::vector<uint32_t>{0, 1});
+
+	// a face cannot be its own hole
+	const std::vector<uint32_t> selfHoleIndices = {0};
+	CHECK_FALSE(HoleBridging::bridgeHoles(bf, vtx.data(), vtx.size(), counts.data(), counts.size(),
+	                                      holeCounts.data(), holeCounts.size(), selfHoleIndices.data(),
+	                                      selfHoleIndices.size(), vertexIndices.data(), vertexIndices.size(), nullptr,
+	                                      0, nullptr, nullptr, nullptr, nullptr, 0, nullptr, 0));
+}
+
+namespace {
+
+// checks if two edges of the face (in the xy plane) cross each other, touching edges are fine
+bool hasCrossingEdges(const std::vector<double>& vtx, const std::vector<uint32_t>& vertexIndices) {
+	auto cross = [&vtx](uint32_t o, uint32_t a, uint32_t b) {
+		return (vtx[3 * a] - vtx[3 * o]) * (vtx[3 * b + 1] - vtx[3 * o + 1]) -
+		       (vtx[3 * a + 1] - vtx[3 * o + 1]) * (vtx[3 * b] - vtx[3 * o]);
+	};
+	const size_t n = vertexIndices.size();
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = i + 1; j < n; j++) {
+			const uint32_t p1 = vertexIndices[i], p2 = vertexIndices[(i + 1) % n];
+			const uint32_t q1 = vertexIndices[j], q2 = vertexIndices[(j + 1) % n];
+			if ((cross(q1, q2, p1) * cross(q1, q2, p2) < 0.0) && (cross(p1, p2, q1) * cross(p1, p2, q2) < 0.0))
+				return true;
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+TEST_CASE("bridge holes without crossing other holes", "[holes]") {
+	// the closest corners of the outer quad and the second hole would be connected right through the first hole
+	const std::vector<double> vtx = {0.0, 0.0, 0.0, 10.0, 0.0, 0.0, 10.0, 10.0, 0.0, 0.0, 10.0, 0.0,
+	                                 1.5, 1.0, 0.0, 2.5, 1.0, 0.0, 2.5, 2.0,  0.0, 1.5, 2.0,  0.0,
+	                                 3.0, 3.0, 0.0, 4.0, 3.0, 0.0, 4.0, 4.0,  0.0, 3.0, 4.0,  0.0};
+	const std::vector<uint32_t> counts = {4, 4, 4};
+	const std::vector<uint32_t> holeCounts = {2, 0, 0};
+	const std::vector<uint32_t> holeIndices = {2, 1};
+	const std::vector<uint32_t> vertexIndices = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+	const std::vector<uint32_t> faceRanges = {0, 3};
+
+	HoleBridging::BridgedFaces bf;
+	REQUIRE(HoleBridging::bridgeHoles(bf, vtx.data(), vtx.size(), counts.data(), counts.size(), holeCounts.data(),
+	                                  holeCounts.size(), holeIndices.data(), holeIndices.size(), vertexIndices.data(),
+	                                  vertexIndices.size(), nullptr, 0, nullptr, nullptr, nullptr, nullptr, 0,
+	                                  faceRanges.data(), faceRanges.size()));
+
+	CHECK(bf.counts == std::vector<uint32_t>{16});
+	CHECK_FALSE(hasCrossingEdges(vtx, bf.vertexIndices));
+}
+
+TEST_CASE("generate and bridge polygon holes", "[holes]") {
+	const std::vector<std::filesystem::path> initialShapeSources = {testDataPath / "holes" /
+	                                                                "example_bad_triang.usdexport1.usd"};
+	const std::vector<std::wstring> initialShapeURIs = {toFileURI(initialShapeSources[0])};
+	const std::vector<std::wstring> startRules = {L"Default$Shape"};
+	const std::filesystem::path rpkPath = testDataPath / "holes" / "do_cleanup.rpk";
+	const std::wstring ruleFile = L"bin/do_cleanup.cgb";
+
+	TestCallbacks tc;
+	generate(tc, prtCtx, rpkPath, ruleFile, initialShapeURIs, startRules, false);
+
+	REQUIRE(tc.results.size() == 1);
+	const CallbackResult& cr = *tc.results[0];
+
+	std::vector<const uint32_t*> uvCounts, uvIndices;
+	std::vector<size_t> uvCountsSizes, uvIndicesSizes;
+	for (size_t uvSet = 0; uvSet < cr.uvCounts.size(); uvSet++) {
+		uvCounts.push_back(cr.uvCounts[uvSet].data());
+		uvCountsSizes.push_back(cr.uvCounts[uvSet].size());
+		uvIndices.push_back(cr.uvIndices[uvSet].data());
+		uvIndicesSizes.push_back(cr.uvIndices[uvSet].size());
+	}
+
+	HoleBridging::BridgedFaces bf;
+	REQUIRE(HoleBridging::bridgeHoles(bf, cr.vtx.data(), cr.vtx.size(), cr.cnts.data(), cr.cnts.size(),
+	                                  cr.holeCnts.data(), cr.holeCnts.size(), cr.holeIdx.data(), cr.holeIdx.size(),
+	                                  cr.vtxIdx.data(), cr.vtxIdx.size(), cr.nrmIdx.data(), cr.nrmIdx.size(),
+	                                  uvCounts.data(), uvCountsSizes.data(), uvIndices.data(), uvIndicesSizes.data(),
+	                                  static_cast<uint32_t>(cr.uvCounts.size()), cr.faceRanges.data(),
+	                                  cr.faceRanges.size()));
+
+	REQUIRE(bf.counts.size() == 26); // the 4 holes are merged into the top face
+
+	// each hole adds its corners plus the two corners of its bridge to the top face
+	uint32_t expectedTopCount = cr.cnts[25];
+	for (const uint32_t hole : cr.holeIdx)
+		expectedTopCount += cr.cnts[hole] + 2;
+	CHECK(bf.counts[25] == expectedTopCount);
+	CHECK(bf.vertexIndices.size() == cr.vtxIdx.size() + 2 * cr.holeIdx.size());
+	CHECK(bf.normalIndices.size() == (cr.nrmIdx.empty() ? 0 : bf.vertexIndices.size()));
+	CHECK(std::equal(bf.counts.begin(), bf.counts.begin() + 25, cr.cnts.begin()));
+}
+
+TEST_CASE("detect occlusion queries in compiled rules", "[occlusion]") {
+	using namespace OcclusionDetection;
+
+	auto scan = [](const std::string& s) { return containsOcclusionQueries(s.data(), s.size()); };
+	CHECK_FALSE(scan(""));
+	CHECK_FALSE(scan("extrude\0split\0comp"));
+	CHECK(scan(std::string("extrude\0inside\0comp", 19)));
+	CHECK(scan(std::string("o\0v\0e\0r\0l\0a\0p\0s\0", 16))); // UTF-16
+	CHECK(scan("contextCount"));
+
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / "pld_test_occlusion_detection";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir / "bin");
+	CHECK(usesOcclusionQueries(dir)); // no rules at all, do not skip
+	CHECK(usesOcclusionQueries(dir / "missing")); // scan errors do not skip either
+
+	auto writeRule = [&dir](const std::string& name, const std::string& content) {
+		std::ofstream out(dir / "bin" / name, std::ios::binary);
+		out.write(content.data(), content.size());
+	};
+	writeRule("main.cgb", "extrude split comp");
+	writeRule("notes.txt", "touches"); // not a compiled rule
+	CHECK_FALSE(usesOcclusionQueries(dir));
+	writeRule("imported.cgb", "touches");
+	CHECK(usesOcclusionQueries(dir));
+
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("spatial grid finds neighbouring boxes", "[occlusion]") {
+	auto createBox = [](double x0, double z0, double x1, double z1) {
+		BoundingBox b;
+		b.add(x0, 0.0, z0);
+		b.add(x1, 10.0, z1);
+		return b;
+	};
+
+	// a row of 10 x 10 lots, 5 apart, plus an empty box and a box covering all lots
+	std::vector<BoundingBox> boxes;
+	for (size_t i = 0; i < 20; i++)
+		boxes.push_back(createBox(i * 15.0, 0.0, i * 15.0 + 10.0, 10.0));
+	boxes.emplace_back();
+	boxes.push_back(createBox(-100.0, -100.0, 400.0, 200.0));
+
+	CHECK(boxes[5].getDistance(boxes[6]) == Approx(5.0));
+	CHECK(boxes[5].getDistance(boxes[21]) == 0.0);
+
+	const SpatialGrid grid(boxes, 20.0);
+	CHECK(grid.query(boxes[5], 6.0) == std::vector<size_t>{4, 5, 6, 21});
+	CHECK(grid.query(boxes[5], 4.0) == std::vector<size_t>{5, 21});
+	CHECK(grid.query(createBox(1000.0, 1000.0, 1001.0, 1001.0), 1.0).empty());
+	CHECK(grid.query(BoundingBox(), 1.0).empty());
+
+	// the cell size is limited by the extent of the boxes
+	const SpatialGrid tinyCells(boxes, 1e-9);
+	CHECK(tinyCells.query(boxes[5], 6.0) == std::vector<size_t>{4, 5, 6, 21});
+
+	// boxes without extent and a zero radius, near the origin and far away
+	const std::vector<BoundingBox> points = {createBox(0.0, 0.0, 0.0, 0.0), createBox(0.0, 0.0, 0.0, 0.0)};
+	const SpatialGrid pointGrid(points, 0.0);
+	CHECK(pointGrid.query(points[0], 0.0) == std::vector<size_t>{0, 1});
+	CHECK(pointGrid.query(points[0], 1e300) == std::vector<size_t>{0, 1});
+
+	const std::vector<BoundingBox> farPoints = {createBox(1e12, 1e12, 1e12, 1e12), createBox(1e12, 1e12, 1e12, 1e12)};
+	const SpatialGrid farPointGrid(farPoints, 0.0);
+	CHECK(farPointGrid.query(farPoints[1], 0.0) == std::vector<size_t>{0, 1});
+}
+
+TEST_CASE("morton code orders boxes along the ground plane", "[occlusion]") {
+	auto createBox = [](double x, double z) {
+		BoundingBox b;
+		b.add(x, 0.0, z);
+		b.add(x + 1.0, 5.0, z + 1.0);
+		return b;
+	};
+
+	BoundingBox extent;
+	extent.add(0.0, 0.0, 0.0);
+	extent.add(100.0, 0.0, 100.0);
+
+	// each quadrant of the extent is visited completely before the next one
+	const uint64_t lowerLeft = getMortonCode(createBox(10.0, 10.0), extent);
+	const uint64_t lowerLeft2 = getMortonCode(createBox(40.0, 40.0), extent);
+	const uint64_t lowerRight = getMortonCode(createBox(60.0, 10.0), extent);
+	const uint64_t upperLeft = getMortonCode(createBox(10.0, 60.0), extent);
+	const uint64_t upperRight = getMortonCode(createBox(90.0, 90.0), extent);
+	CHECK(lowerLeft < lowerLeft2);
+	CHECK(lowerLeft2 < lowerRight);
+	CHECK(lowerRight < upperLeft);
+	CHECK(upperLeft < upperRight);
+
+	// the height and boxes outside of the extent do not matter
+	CHECK(getMortonCode(createBox(-50.0, -50.0), extent) == 0);
+	CHECK(getMortonCode(BoundingBox(), extent) == 0);
+	CHECK(getMortonCode(createBox(10.0, 10.0), BoundingBox()) == 0);
+}
+
+TEST_CASE("chunk scheduler covers all items exactly once", "[scheduler]") {
+	const size_t numItems = 103;
+	const size_t numWorkers = 4;
+	ChunkScheduler scheduler(numItems, 10, numWorkers);
+	CHECK(scheduler.getNumChunks() == 11);
+
+	std::vector<int> visits(numItems, 0);
+	for (size_t wi = 0; wi < numWorkers; wi++) {
+		while (const auto chunk = scheduler.next(wi)) {
+			CHECK(chunk->size() > 0);
+			CHECK(chunk->size() <= 10);
+			for (size_t i = chunk->begin; i < chunk->end; i++)
+				visits[i]++;
+		}
+	}
+	CHECK(std::all_of(visits.begin(), visits.end(), [](int v) { return v == 1; }));
+	CHECK(scheduler.getNumSteals() > 0); // the first worker drained the queues of all others
+}
+
+TEST_CASE("chunk scheduler hands out own chunks in order", "[scheduler]") {
+	ChunkScheduler scheduler(8, 2, 2);
+
+	const auto c0 = scheduler.next(0);
+	REQUIRE(c0);
+	CHECK(c0->begin == 0);
+	CHECK(c0->end == 2);
+
+	const auto c1 = scheduler.next(1);
+	REQUIRE(c1);
+	CHECK(c1->begin == 4);
+	CHECK(c1->end == 6);
+
+	const auto c2 = scheduler.next(0);
+	REQUIRE(c2);
+	CHECK(c2->begin == 2);
+
+	// worker 0 is drained and steals the last chunk of worker 1
+	const auto c3 = scheduler.next(0);
+	REQUIRE(c3);
+	CHECK(c3->begin == 6);
+	CHECK(scheduler.getNumSteals() == 1);
+
+	CHECK_FALSE(scheduler.next(1));
+	CHECK_FALSE(scheduler.next(0));
+}
+
+TEST_CASE("chunk scheduler with concurrent workers", "[scheduler]") {
+	const size_t numItems = 10000;
+	const size_t numWorkers = 8;
+	ChunkScheduler scheduler(numItems, 0, numWorkers);
+	CHECK(scheduler.getNumChunks() == numWorkers * 8);
+
+	std::vector<std::future<size_t>> futures;
+	for (size_t wi = 0; wi < numWorkers; wi++) {
+		futures.emplace_back(std::async(std::launch::async, [&scheduler, wi]() {
+			size_t sum = 0;
+			while (const auto chunk = scheduler.next(wi)) {
+				for (size_t i = chunk->begin; i < chunk->end; i++)
+					sum += i;
+			}
+			return sum;
+		}));
+	}
+
+	size_t total = 0;
+	for (auto& f : futures)
+		total += f.get();
+	CHECK(total == numItems * (numItems - 1) / 2);
+}
+
+TEST_CASE("cost-balanced chunk scheduler", "[scheduler]") {
+	std::vector<double> costs(100, 1.0);
+	costs[10] = 100.0; // one expensive initial shape
+
+	ChunkScheduler scheduler(costs, 4, 4);
+
+	std::vector<int> visits(costs.size(), 0);
+	std::vector<double> workerCosts(4, 0.0);
+	for (size_t wi = 0; wi < 4; wi++) {
+		bool first = true;
+		while (const auto chunk = scheduler.next(wi)) {
+			if (first && wi == 1) {
+				// the expensive shape closes its chunk and fills the budget of the second worker
+				CHECK(chunk->end == 11);
+			}
+			first = false;
+			for (size_t i = chunk->begin; i < chunk->end; i++)
+				visits[i]++;
+		}
+	}
+	CHECK(std::all_of(visits.begin(), visits.end(), [](int v) { return v == 1; }));
+}
+
+TEST_CASE("cost-balanced chunk scheduler without costs falls back to counts", "[scheduler]") {
+	const std::vector<double> costs(10, 0.0);
+	ChunkScheduler scheduler(costs, 3, 2);
+	CHECK(scheduler.getNumChunks() == 4);
+}
+
+TEST_CASE("chunk scheduler keeps groups apart", "[scheduler]") {
+	// e.g. three rule packages with 7, 1 and 12 initial shapes
+	const std::vector<size_t> groupEnds = {7, 8, 20};
+	auto checkChunks = [&groupEnds](ChunkScheduler& scheduler) {
+		std::vector<int> visits(20, 0);
+		while (const auto chunk = scheduler.next(0)) {
+			const auto groupEnd = std::upper_bound(groupEnds.begin(), groupEnds.end(), chunk->begin);
+			REQUIRE(groupEnd != groupEnds.end());
+			CHECK(chunk->end <= *groupEnd);
+			for (size_t i = chunk->begin; i < chunk->end; i++)
+				visits[i]++;
+		}
+		CHECK(std::all_of(visits.begin(), visits.end(), [](int v) { return v == 1; }));
+	};
+
+	ChunkScheduler countScheduler(20, 5, 2, groupEnds);
+	CHECK(countScheduler.getNumChunks() == 6); // 5 + 2, 1, 5 + 5 + 2
+	checkChunks(countScheduler);
+
+	ChunkScheduler costScheduler(std::vector<double>(20, 1.0), 5, 2, groupEnds);
+	CHECK(costScheduler.getNumChunks() == 6);
+	checkChunks(costScheduler);
+
+	// invalid group ends are ignored
+	ChunkScheduler invalidGroups(10, 5, 2, {0, 5, 3, 10, 42});
+	CHECK(invalidGroups.getNumChunks() == 2);
+}
+
+TEST_CASE("default chunk size", "[scheduler]") {
+	CHECK(ChunkScheduler::getDefaultChunkSize(0, 4) == 1);
+	CHECK(ChunkScheduler::getDefaultChunkSize(1, 4) == 1);
+	CHECK(ChunkScheduler::getDefaultChunkSize(64, 4) == 2);
+	CHECK(ChunkScheduler::getDefaultChunkSize(65, 4) == 3);
+	CHECK(ChunkScheduler::getDefaultChunkSize(1000, 0) == 125);
+}
+
+TEST_CASE("thread pool runs all submitted tasks", "[threadpool]") {
+	ThreadPool threadPool(4);
+	CHECK(threadPool.getNumThreads() == 4);
+
+	std::atomic<size_t> counter = 0;
+	std::vector<std::future<size_t>> futures;
+	for (size_t i = 0; i < 100; i++) {
+		futures.emplace_back(threadPool.submit([&counter, i]() {
+			counter++;
+			return i;
+		}));
+	}
+
+	size_t sum = 0;
+	for (auto& f : futures)
+		sum += f.get();
+	CHECK(sum == 100 * 99 / 2);
+	CHECK(counter == 100);
+}
+
+TEST_CASE("thread pool forwards exceptions to the future", "[threadpool]") {
+	ThreadPool threadPool(1);
+	auto f = threadPool.submit([]() { throw std::runtime_error("boom"); });
+	CHECK_THROWS_AS(f.get(), std::runtime_error);
+
+	// the worker survives the exception
+	CHECK(threadPool.submit([]() { return 42; }).get() == 42);
+}
+
+TEST_CASE("thread pool parallel for visits each item once", "[threadpool]") {
+	ThreadPool threadPool(3);
+	std::vector<std::atomic<size_t>> visits(10);
+	threadPool.parallelFor(visits.size(), [&visits](size_t i) { visits[i]++; });
+	CHECK(std::all_of(visits.begin(), visits.end(), [](const std::atomic<size_t>& v) { return v == 1; }));
+
+	threadPool.parallelFor(0, [](size_t) { FAIL(); });
+}
+
+TEST_CASE("thread pool parallel for finishes all tasks before forwarding an exception", "[threadpool]") {
+	ThreadPool threadPool(4);
+	std::atomic<size_t> finished{0};
+	auto f = [&finished](size_t i) {
+		if (i == 0)
+			throw std::runtime_error("boom");
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		finished++;
+	};
+	CHECK_THROWS_AS(threadPool.parallelFor(4, f), std::runtime_error);
+	CHECK(finished == 3); // the other tasks must not outlive the call, they reference the caller's stack
+}
+
+TEST_CASE("chunk scheduler stops handing out chunks once cancelled", "[threadpool]") {
+	constexpr size_t NUM_WORKERS = 2;
+	constexpr size_t CANCEL_AT = 5;
+	ChunkScheduler scheduler(1000, 10, NUM_WORKERS);
+	REQUIRE(scheduler.getNumChunks() == 100);
+
+	// like the generate batches: the workers process chunks until all are done or the token is cancelled
+	ThreadPool threadPool(NUM_WORKERS);
+	CancellationToken cancellation;
+	std::atomic<size_t> started{0};
+	std::vector<std::future<size_t>> futures;
+	for (size_t wi = 0; wi < NUM_WORKERS; wi++) {
+		futures.emplace_back(threadPool.submit([&scheduler, &cancellation, &started, wi]() {
+			return scheduler.run(wi, cancellation, [&cancellation, &started](const ChunkScheduler::Chunk&) {
+				if (++started == CANCEL_AT)
+					cancellation.cancel();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			});
+		}));
+	}
+	size_t processed = 0;
+	for (auto& f : futures)
+		processed += f.get();
+
+	// the other worker might have started its chunk right before the token was cancelled
+	CHECK(processed == started);
+	CHECK(started >= CANCEL_AT);
+	CHECK(started < CANCEL_AT + NUM_WORKERS);
+
+	// no further chunk starts, even though there are chunks left
+	const size_t processedAfterCancel =
+	        scheduler.run(0, cancellation, [](const ChunkScheduler::Chunk&) { FAIL("chunk started after cancel"); });
+	CHECK(processedAfterCancel == 0);
+	CHECK(scheduler.next(0).has_value());
+}
+
+TEST_CASE("split thread budget between batches and PRT workers", "[threadpool]") {
+	SECTION("automatic") {
+		const ThreadBudget tb = getThreadBudget(64, 1000, 0);
+		CHECK(tb.batches == 64);
+		CHECK(tb.workersPerBatch == 1);
+	}
+
+	SECTION("automatic with few initial shapes") {
+		const ThreadBudget tb = getThreadBudget(64, 4, 0);
+		CHECK(tb.batches == 4);
+		CHECK(tb.workersPerBatch == 16);
+	}
+
+	SECTION("requested") {
+		const ThreadBudget tb = getThreadBudget(64, 1000, 8);
+		CHECK(tb.batches == 8);
+		CHECK(tb.workersPerBatch == 8);
+	}
+
+	SECTION("requested exceeds cores") {
+		const ThreadBudget tb = getThreadBudget(8, 1000, 100);
+		CHECK(tb.batches == 8);
+		CHECK(tb.workersPerBatch == 1);
+	}
+
+	SECTION("no initial shapes") {
+		const ThreadBudget tb = getThreadBudget(8, 0, 0);
+		CHECK(tb.batches == 1);
+		CHECK(tb.workersPerBatch == 8);
+	}
+}
+
+TEST_CASE("cost model", "[costmodel]") {
+	CostModel costModel;
+	const std::filesystem::path rpk = "/foo/bar.rpk";
+
+	CHECK(CostModel::getUnits(2, 8) > CostModel::getUnits(1, 4));
+	CHECK(costModel.getSecondsPerUnit(rpk, L"Default$Lot") == 1.0);
+	CHECK_FALSE(costModel.hasMeasurement(rpk, L"Default$Lot"));
+
+	costModel.addMeasurement(rpk, L"Default$Lot", 100.0, 1.0);
+	CHECK(costModel.hasMeasurement(rpk, L"Default$Lot"));
+	CHECK(costModel.getSecondsPerUnit(rpk, L"Default$Lot") == Approx(0.01));
+
+	// unknown start rules use the mean of all measurements
+	costModel.addMeasurement(rpk, L"Default$Tower", 100.0, 3.0);
+	CHECK(costModel.getSecondsPerUnit(rpk, L"Default$Shed") == Approx(0.02));
+	CHECK(costModel.getSecondsPerUnit("/other.rpk", L"Default$Lot") == Approx(0.02));
+
+	// new measurements are smoothed with earlier ones
+	costModel.addMeasurement(rpk, L"Default$Lot", 100.0, 3.0);
+	CHECK(costModel.getSecondsPerUnit(rpk, L"Default$Lot") == Approx(0.02));
+
+	// invalid measurements are ignored
+	costModel.addMeasurement(rpk, L"Default$Empty", 0.0, 1.0);
+	CHECK_FALSE(costModel.hasMeasurement(rpk, L"Default$Empty"));
+}
+
+TEST_CASE("content hash", "[contenthash]") {
+	SECTION("is deterministic and sensitive to the content") {
+		const std::vector<uint32_t> faceCounts = {4, 4, 3};
+		CHECK(ContentHash().add(faceCounts).add(std::wstring(L"Lot")).get() ==
+		      ContentHash().add(faceCounts).add(std::wstring(L"Lot")).get());
+		CHECK(ContentHash().add(faceCounts).get() != ContentHash().add(std::vector<uint32_t>{4, 4, 4}).get());
+		CHECK(ContentHash().add(1.0).get() != ContentHash().add(-1.0).get());
+		CHECK(ContentHash().add(std::wstring(L"ab")).add(std::wstring(L"c")).get() !=
+		      ContentHash().add(std::wstring(L"a")).add(std::wstring(L"bc")).get());
+	}
+
+	SECTION("attribute maps do not depend on the order of the keys") {
+		AttributeMapBuilderUPtr amb(prt::AttributeMapBuilder::create());
+		amb->setFloat(L"Default$height", 12.0);
+		amb->setString(L"Default$type", L"tower");
+		const AttributeMapUPtr am1(amb->createAttributeMapAndReset());
+
+		amb->setString(L"Default$type", L"tower");
+		amb->setFloat(L"Default$height", 12.0);
+		const AttributeMapUPtr am2(amb->createAttributeMapAndReset());
+
+		amb->setString(L"Default$type", L"tower");
+		amb->setFloat(L"Default$height", 13.0);
+		const AttributeMapUPtr am3(amb->createAttributeMapAndReset());
+
+		CHECK(ContentHash().add(am1.get()).get() == ContentHash().add(am2.get()).get());
+		CHECK(ContentHash().add(am1.get()).get() != ContentHash().add(am3.get()).get());
+	}
+}
+
+namespace {
+
+GeneratedModelSPtr createGeneratedModel(size_t numVertices) {
+	auto model = std::make_shared<GeneratedModel>();
+	auto mesh = std::make_shared<GeneratedMesh>();
+	mesh->vtx.assign(numVertices * 3, 0.0);
+	mesh->counts.assign(1, static_cast<uint32_t>(numVertices));
+	model->meshes.emplace_back(std::move(mesh));
+	return model;
+}
+
+} // namespace
+
+TEST_CASE("generated model cache", "[modelcache]") {
+	const GeneratedModelSPtr smallModel = createGeneratedModel(4);
+	const size_t modelSize = smallModel->getSize();
+	GeneratedModelCache cache(3 * modelSize);
+
+	CHECK_FALSE(cache.get(1));
+	cache.insert(1, smallModel);
+	cache.insert(2, createGeneratedModel(4));
+	cache.insert(3, createGeneratedModel(4));
+	CHECK(cache.get(1) == smallModel);
+
+	// the least recently used model (2) is evicted
+	cache.insert(4, createGeneratedModel(4));
+	CHECK_FALSE(cache.get(2));
+	CHECK(cache.get(1));
+	CHECK(cache.get(3));
+	CHECK(cache.get(4));
+
+	// models exceeding the budget on their own are not stored
+	cache.insert(5, createGeneratedModel(1000));
+	CHECK_FALSE(cache.get(5));
+
+	const GeneratedModelCache::Stats stats = cache.getStats();
+	CHECK(stats.hits == 4);
+	CHECK(stats.misses == 3);
+	CHECK(stats.insertions == 4);
+	CHECK(stats.evictions == 1);
+	CHECK(stats.entries == 3);
+	CHECK(stats.bytes == 3 * modelSize);
+	CHECK(stats.budget == 3 * modelSize);
+
+	cache.clear();
+	CHECK(cache.getStats().entries == 0);
+	CHECK(cache.getStats().bytes == 0);
+}
+
+TEST_CASE("serialize generated model", "[modelcache]") {
+	GeneratedModel model;
+	auto meshPtr = std::make_shared<GeneratedMesh>();
+	model.meshes.emplace_back(meshPtr);
+	GeneratedMesh& mesh = *meshPtr;
+	mesh.vtx = {0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0, 0.0, 1.0};
+	mesh.counts = {3};
+	mesh.vertexIndices = {0, 1, 2};
+	mesh.uvs = {{0.0, 0.0, 1.0, 0.0, 1.0, 1.0}};
+	mesh.uvCounts = {{3}};
+	mesh.uvIndices = {{0, 1, 2}};
+	mesh.faceRanges = {0, 1};
+	mesh.shapeIDs = {7};
+
+	AttributeMapBuilderUPtr amb(prt::AttributeMapBuilder::create());
+	amb->setString(L"diffuseMap", L"tex/wall.png");
+	const double diffuseColor[] = {0.5, 0.25, 1.0};
+	amb->setFloatArray(L"diffuseColor", diffuseColor, 3);
+	mesh.materials.emplace_back(amb->createAttributeMapAndReset());
+	mesh.shapeAttributes.emplace_back(); // shape without attributes
+
+	const std::vector<uint8_t> data = GeneratedModelSerialization::serialize(42, model);
+	const GeneratedModelSPtr restored = GeneratedModelSerialization::deserialize(42, data.data(), data.size());
+	REQUIRE(restored);
+	REQUIRE(restored->meshes.size() == 1);
+
+	const GeneratedMesh& rm = *restored->meshes.front();
+	CHECK(rm.vtx == mesh.vtx);
+	CHECK(rm.counts == mesh.counts);
+	CHECK(rm.vertexIndices == mesh.vertexIndices);
+	CHECK(rm.uvs == mesh.uvs);
+	CHECK(rm.uvIndices == mesh.uvIndices);
+	CHECK(rm.faceRanges == mesh.faceRanges);
+	CHECK(rm.shapeIDs == mesh.shapeIDs);
+	REQUIRE(rm.materials.size() == 1);
+	CHECK(std::wstring(rm.materials.front()->getString(L"diffuseMap")) == L"tex/wall.png");
+	size_t n = 0;
+	const double* c = rm.materials.front()->getFloatArray(L"diffuseColor", &n);
+	CHECK(std::vector<double>(c, c + n) == std::vector<double>(diffuseColor, diffuseColor + 3));
+	REQUIRE(rm.shapeAttributes.size() == 1);
+	CHECK_FALSE(rm.shapeAttributes.front());
+
+	// wrong key and truncated data are rejected
+	CHECK_FALSE(GeneratedModelSerialization::deserialize(43, data.data(), data.size()));
+	CHECK_FALSE(GeneratedModelSerialization::deserialize(42, data.data(), data.size() - 1));
+}
+
+TEST_CASE("generated model disk cache", "[modelcache]") {
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / "pld_test_model_cache";
+	std::filesystem::remove_all(dir);
+
+	GeneratedModelDiskCache cache(dir);
+	CHECK_FALSE(cache.get(1));
+	CHECK(cache.put(1, *createGeneratedModel(4)));
+	CHECK(std::filesystem::exists(cache.getPath(1)));
+
+	// another instance (e.g. another process) sees the model
+	GeneratedModelDiskCache otherCache(dir);
+	const GeneratedModelSPtr model = otherCache.get(1);
+	REQUIRE(model);
+	CHECK(model->meshes.front()->vtx.size() == 12);
+
+	const GeneratedModelDiskCache::Stats stats = cache.getStats();
+	CHECK(stats.hits == 0);
+	CHECK(stats.misses == 1);
+	CHECK(stats.writes == 1);
+	CHECK(stats.failedWrites == 0);
+	CHECK(otherCache.getStats().hits == 1);
+
+	std::filesystem::remove_all(dir);
+}